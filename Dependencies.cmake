@@ -31,6 +31,8 @@ cpmaddpackage("gh:catchorg/Catch2@3.3.2")
 
 cpmaddpackage("gh:CLIUtils/CLI11@2.3.2")
 
+cpmaddpackage("gh:nlohmann/json@3.11.3")
+
 # don't work
 #   cpmaddpackage("gh:spnda/fastgltf@0.8.0")
 
@@ -65,6 +67,13 @@ cpmaddpackage(
 
 cpmaddpackage("gh:GPUOpen-LibrariesAndSDKs/VulkanMemoryAllocator@3.1.0")
 
+cpmaddpackage("gh:tinyobjloader/tinyobjloader@2.0.0rc13")
+
+# the installed package exports a namespaced target, a source build doesn't
+if(NOT TARGET tinyobjloader::tinyobjloader)
+  add_library(tinyobjloader::tinyobjloader ALIAS tinyobjloader)
+endif()
+
 find_package(Vulkan REQUIRED)
 
 add_subdirectory(third_party)
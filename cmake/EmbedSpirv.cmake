@@ -0,0 +1,51 @@
+#
+# Turns a compiled SPIR-V binary into a header holding it as a constexpr word
+# array, so shader modules can be created without touching the filesystem.
+#
+# usage: cmake -DINPUT=<file.spv> -DOUTPUT=<file.hpp> -DNAME=<identifier> -P
+# EmbedSpirv.cmake
+#
+file(READ ${INPUT} SPIRV_HEX HEX)
+string(LENGTH "${SPIRV_HEX}" SPIRV_HEX_LENGTH)
+math(EXPR SPIRV_WORD_COUNT "${SPIRV_HEX_LENGTH} / 8")
+
+if(SPIRV_WORD_COUNT EQUAL 0)
+  message(FATAL_ERROR "${INPUT} is empty")
+endif()
+
+# spirv is a stream of little endian 32 bit words
+set(SPIRV_WORDS "")
+math(EXPR LAST_WORD "${SPIRV_WORD_COUNT} - 1")
+foreach(WORD RANGE ${LAST_WORD})
+  math(EXPR OFFSET "${WORD} * 8")
+  string(SUBSTRING "${SPIRV_HEX}" ${OFFSET} 8 BYTES)
+  string(SUBSTRING "${BYTES}" 0 2 B0)
+  string(SUBSTRING "${BYTES}" 2 2 B1)
+  string(SUBSTRING "${BYTES}" 4 2 B2)
+  string(SUBSTRING "${BYTES}" 6 2 B3)
+  string(APPEND SPIRV_WORDS "0x${B3}${B2}${B1}${B0},")
+  math(EXPR COLUMN "${WORD} % 6")
+  if(COLUMN EQUAL 5)
+    string(APPEND SPIRV_WORDS "\n    ")
+  else()
+    string(APPEND SPIRV_WORDS " ")
+  endif()
+endforeach()
+
+get_filename_component(INPUT_NAME ${INPUT} NAME)
+
+file(
+  WRITE ${OUTPUT}
+  "// generated from ${INPUT_NAME} by EmbedSpirv.cmake. do not edit
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace spirv {
+
+inline constexpr std::array<uint32_t, ${SPIRV_WORD_COUNT}> ${NAME}{
+    ${SPIRV_WORDS}};
+
+}  // namespace spirv
+")
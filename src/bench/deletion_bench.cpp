@@ -0,0 +1,137 @@
+// destroys 100k transient buffers through the std::function DeletionQueue and
+// through RetireQueue, counting heap allocations made along the way. runs
+// the engine headless to get a device
+#include <fmt/format.h>
+#include <vk_mem_alloc.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "deletion_queue.hpp"
+#include "engine.hpp"
+#include "helpers.hpp"
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t BUFFER_COUNT = 100'000;
+// buffers retired per simulated frame
+constexpr uint32_t BUFFERS_PER_FRAME = 1000;
+
+using Buffers = std::vector<std::pair<VkBuffer, VmaAllocation>>;
+
+Buffers create_buffers(VmaAllocator allocator) {
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = 256;
+  bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+
+  VmaAllocationCreateInfo allocInfo{};
+  allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+
+  Buffers buffers(BUFFER_COUNT);
+  for (auto& [buffer, allocation] : buffers) {
+    vk_check(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer,
+                             &allocation, nullptr));
+  }
+  return buffers;
+}
+
+void report(const char* name, Clock::duration elapsed, uint64_t allocs) {
+  fmt::print("{:<28} {:8.1f} ns/buffer, {} heap allocations\n", name,
+             double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        elapsed)
+                        .count()) /
+                 BUFFER_COUNT,
+             allocs);
+}
+
+void bench_function_queue(Engine& engine) {
+  Buffers buffers = create_buffers(engine._allocator);
+  VmaAllocator allocator = engine._allocator;
+
+  const uint64_t before = allocations.load();
+  auto start = Clock::now();
+
+  DeletionQueue queue;
+  for (auto [buffer, allocation] : buffers) {
+    queue.push_function([allocator, buffer, allocation]() {
+      vmaDestroyBuffer(allocator, buffer, allocation);
+    });
+  }
+  queue.flush();
+
+  report("DeletionQueue", Clock::now() - start, allocations.load() - before);
+}
+
+// retires a frame's worth of buffers per simulated frame and collects with
+// the same frames in flight lag as Engine::draw, so the ring never grows
+void bench_retire_queue(Engine& engine) {
+  Buffers buffers = create_buffers(engine._allocator);
+  RetireQueue queue{engine._device, engine._allocator};
+
+  const uint64_t before = allocations.load();
+  auto start = Clock::now();
+
+  const uint64_t lag = engine._framesInFlight;
+  uint64_t frameValue = 1;
+  for (uint32_t i = 0; i < BUFFER_COUNT; i++) {
+    if (i != 0 && i % BUFFERS_PER_FRAME == 0) {
+      frameValue++;
+      queue.collect(frameValue > lag ? frameValue - lag : 0);
+    }
+    queue.retire(buffers[i].first, frameValue, buffers[i].second);
+  }
+  queue.collect(frameValue);
+
+  report("RetireQueue", Clock::now() - start, allocations.load() - before);
+  fmt::print("  ring capacity {} entries\n", queue.capacity());
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  // aligned_alloc wants the size to be a multiple of the alignment
+  const auto alignment = static_cast<size_t>(align);
+  size = (size + alignment - 1) & ~(alignment - 1);
+  if (void* ptr = std::aligned_alloc(alignment, size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t /*size*/) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t /*align*/) noexcept {
+  std::free(ptr);
+}
+void operator delete(void* ptr, size_t /*size*/,
+                     std::align_val_t /*align*/) noexcept {
+  std::free(ptr);
+}
+
+int main() {
+  Engine engine{EngineConfig{.headless = true}};
+
+  bench_function_queue(engine);
+  bench_retire_queue(engine);
+
+  return 0;
+}
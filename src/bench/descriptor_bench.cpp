@@ -0,0 +1,143 @@
+// per-frame cost of writing texture descriptors: one descriptor set per draw
+// allocated and written every frame, the bindless table in a descriptor set
+// and the bindless table in a descriptor buffer. runs the engine headless to
+// get a device
+#include <fmt/format.h>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "bindless.hpp"
+#include "engine.hpp"
+#include "helpers.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t FRAMES = 1000;
+// descriptors rewritten per frame, think one per draw
+constexpr uint32_t DESCRIPTORS_PER_FRAME = 1024;
+
+void report(const char* name, Clock::duration elapsed) {
+  const auto ns = static_cast<double>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  fmt::print("{:<20} {:8.2f} us/frame, {:6.1f} ns/descriptor\n", name,
+             ns / FRAMES / 1000., ns / FRAMES / DESCRIPTORS_PER_FRAME);
+}
+
+// what the engine did before the bindless table: reset the pool, allocate a
+// combined image sampler set per draw and write it
+void bench_per_draw_sets(Engine& engine) {
+  VkDescriptorSetLayoutBinding binding{};
+  binding.binding = 0;
+  binding.descriptorCount = 1;
+  binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = 1;
+  layoutInfo.pBindings = &binding;
+
+  VkDescriptorSetLayout layout{};
+  vk_check(vkCreateDescriptorSetLayout(engine._device, &layoutInfo, nullptr,
+                                       &layout));
+
+  VkDescriptorPoolSize poolSize{
+      .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      .descriptorCount = DESCRIPTORS_PER_FRAME};
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = DESCRIPTORS_PER_FRAME;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes = &poolSize;
+
+  VkDescriptorPool pool{};
+  vk_check(vkCreateDescriptorPool(engine._device, &poolInfo, nullptr, &pool));
+
+  const std::vector<VkDescriptorSetLayout> layouts(DESCRIPTORS_PER_FRAME,
+                                                   layout);
+  std::vector<VkDescriptorSet> sets(DESCRIPTORS_PER_FRAME);
+  std::vector<VkWriteDescriptorSet> writes(DESCRIPTORS_PER_FRAME);
+
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.sampler = engine._textureSampler;
+  imageInfo.imageView = engine._textureImage.view;
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  auto start = Clock::now();
+  for (uint32_t frame = 0; frame < FRAMES; frame++) {
+    vk_check(vkResetDescriptorPool(engine._device, pool, 0));
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = pool;
+    allocInfo.descriptorSetCount = DESCRIPTORS_PER_FRAME;
+    allocInfo.pSetLayouts = layouts.data();
+    vk_check(vkAllocateDescriptorSets(engine._device, &allocInfo, sets.data()));
+
+    for (uint32_t i = 0; i < DESCRIPTORS_PER_FRAME; i++) {
+      writes[i] = VkWriteDescriptorSet{
+          .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+          .dstSet = sets[i],
+          .dstBinding = 0,
+          .descriptorCount = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          .pImageInfo = &imageInfo,
+      };
+    }
+    vkUpdateDescriptorSets(engine._device, DESCRIPTORS_PER_FRAME,
+                           writes.data(), 0, nullptr);
+  }
+  report("per draw sets", Clock::now() - start);
+
+  vkDestroyDescriptorPool(engine._device, pool, nullptr);
+  vkDestroyDescriptorSetLayout(engine._device, layout, nullptr);
+}
+
+// rewrites DESCRIPTORS_PER_FRAME slots of a bindless table every frame
+void bench_bindless(Engine& engine, DescriptorBackend backend) {
+  BindlessTable table{engine._device, engine._gpu, engine._allocator,
+                      backend};
+
+  std::vector<uint32_t> slots(DESCRIPTORS_PER_FRAME);
+  for (uint32_t& slot : slots) {
+    slot = table.add_texture(engine._textureImage.view);
+  }
+
+  auto start = Clock::now();
+  for (uint32_t frame = 0; frame < FRAMES; frame++) {
+    for (uint32_t slot : slots) {
+      table.set_texture(slot, engine._textureImage.view);
+    }
+  }
+  report(to_string(backend).data(), Clock::now() - start);
+
+  for (uint32_t slot : slots) {
+    table.remove_texture(slot, 0);
+  }
+}
+
+}  // namespace
+
+int main() {
+  Engine engine{EngineConfig{.headless = true, .descriptorBuffer = true}};
+
+  fmt::print("{} descriptors per frame, {} frames\n", DESCRIPTORS_PER_FRAME,
+             FRAMES);
+
+  bench_per_draw_sets(engine);
+  bench_bindless(engine, DescriptorBackend::Pool);
+
+  if (engine._descriptorBackend == DescriptorBackend::Buffer) {
+    bench_bindless(engine, DescriptorBackend::Buffer);
+  } else {
+    fmt::print("{:<20} skipped, VK_EXT_descriptor_buffer not supported\n",
+               to_string(DescriptorBackend::Buffer));
+  }
+
+  return 0;
+}
@@ -0,0 +1,394 @@
+// renders scripted scenes headless for a fixed number of frames and reports
+// frame times, gpu pass times, draw counts and memory as json. with a
+// baseline it flags scenes that got slower, so it can gate a ci job:
+//
+//   engine_bench --out baseline.json
+//   engine_bench --baseline baseline.json --out current.json
+//   engine_bench --compare current.json --baseline baseline.json
+#include <fmt/format.h>
+
+#include <CLI/CLI.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "engine.hpp"
+#include "helpers.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using nlohmann::json;
+
+struct BenchScene {
+  std::string name;
+  // applied on top of the headless defaults
+  EngineConfig config;
+  // scene drawing the same without occlusion culling, the gpu time saved
+  // against it is reported
+  std::string unculled;
+  // likewise, the same scene without async compute
+  std::string serial;
+};
+
+// the scenes every run goes through. keep names stable, baselines are
+// matched by them
+std::vector<BenchScene> scenes() {
+  std::vector<BenchScene> result;
+
+  result.push_back({.name = "viking_room", .config = {}});
+  result.push_back(
+      {.name = "viking_room_uber", .config = {.uberShaders = true}});
+  // the same frame presented with a blit instead of the compute composite
+  result.push_back(
+      {.name = "viking_room_blit", .config = {.blitPresent = true}});
+  // compare gpu_ms against viking_room, the same vertices pulled by the
+  // shader instead of fed by fixed function vertex input
+  result.push_back({.name = "viking_room_vertex_pulling",
+                    .config = {.vertexPulling = true}});
+  // compare fragment_invocations against viking_room
+  result.push_back(
+      {.name = "viking_room_prepass", .config = {.depthPrepass = true}});
+  result.push_back({.name = "stress_10k", .config = {.drawCopies = 10'000}});
+  // compare cpu_frame_ms against stress_10k, fewer frames in flight wait on
+  // the gpu sooner
+  result.push_back(
+      {.name = "stress_10k_1_frame_in_flight",
+       .config = {.framesInFlight = 1, .drawCopies = 10'000}});
+  result.push_back(
+      {.name = "stress_10k_3_frames_in_flight",
+       .config = {.framesInFlight = 3, .drawCopies = 10'000}});
+  result.push_back({.name = "stress_100k", .config = {.drawCopies = 100'000}});
+  // compare cpu_us_per_draw against stress_100k, every device call goes
+  // through the loader's trampolines
+  result.push_back(
+      {.name = "stress_100k_loader_dispatch",
+       .config = {.drawCopies = 100'000, .loaderDispatch = true}});
+  // compare gpu_ms and cpu_us_per_draw against stress_100k, vertices are
+  // read by the shader and no vertex buffer is bound
+  result.push_back(
+      {.name = "stress_100k_vertex_pulling",
+       .config = {.drawCopies = 100'000, .vertexPulling = true}});
+  result.push_back(
+      {.name = "stress_100k_culled",
+       .config = {.drawCopies = 100'000, .occlusionCulling = true},
+       .unculled = "stress_100k"});
+  // culling and the hi-z pyramid next to the raster work, on the graphics
+  // queue if there is no separate compute queue
+  result.push_back({.name = "stress_100k_culled_async",
+                    .config = {.drawCopies = 100'000,
+                               .occlusionCulling = true,
+                               .asyncCompute = true},
+                    .serial = "stress_100k_culled"});
+  // holding 60 fps by lowering the resolution
+  result.push_back({.name = "stress_100k_dynamic_res",
+                    .config = {.drawCopies = 100'000, .gpuBudgetMs = 16.6}});
+
+  return result;
+}
+
+json percentiles(std::vector<double> samples) {
+  std::ranges::sort(samples);
+  auto at = [&](double p) {
+    auto index = static_cast<size_t>(p * double(samples.size() - 1));
+    return samples[index];
+  };
+
+  return json{
+      {"min", samples.front()},
+      {"avg", std::accumulate(samples.begin(), samples.end(), 0.) /
+                  double(samples.size())},
+      {"p50", at(.5)},
+      {"p95", at(.95)},
+      {"p99", at(.99)},
+      {"max", samples.back()},
+  };
+}
+
+json memory_usage(const Engine& engine) {
+  VkDeviceSize usage{0};
+  for (const HeapBudget& heap : engine._memoryStats->heap_budgets()) {
+    usage += heap.usage;
+  }
+
+  json categories = json::object();
+  for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); i++) {
+    const auto category = static_cast<MemoryCategory>(i);
+    categories[std::string(to_string(category))] =
+        engine._memoryStats->category_bytes(category);
+  }
+
+  return json{{"usage_bytes", usage}, {"categories", categories}};
+}
+
+json run_scene(const BenchScene& scene, const std::string& assetDir,
+               uint32_t warmupFrames, uint32_t measureFrames) {
+  fmt::print("{}: {} warmup + {} frames\n", scene.name, warmupFrames,
+             measureFrames);
+
+  EngineConfig config = scene.config;
+  config.headless = true;
+  config.assetDir = assetDir;
+
+  Engine engine{config};
+
+  for (uint32_t i = 0; i < warmupFrames; i++) {
+    engine.draw();
+  }
+  engine._gpuProfiler->reset();
+  engine._drawCulling->reset_stats();
+  if (engine._dynamicResolution) {
+    engine._dynamicResolution->reset();
+  }
+
+  std::vector<double> cpuMs;
+  cpuMs.reserve(measureFrames);
+  for (uint32_t i = 0; i < measureFrames; i++) {
+    Clock::time_point start = Clock::now();
+    engine.draw();
+    cpuMs.push_back(
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count());
+  }
+  vk_check(vkDeviceWaitIdle(engine._device));
+
+  json gpu = json::object();
+  for (const GpuScopeStats& stats : engine._gpuProfiler->stats()) {
+    gpu[stats.name] = {
+        {"min", stats.min}, {"avg", stats.avg}, {"p99", stats.p99}};
+  }
+
+  const size_t draws = engine._drawContext.objects.size();
+  const double cpuAvgMs =
+      std::accumulate(cpuMs.begin(), cpuMs.end(), 0.) / double(cpuMs.size());
+
+  json result{
+      {"name", scene.name},
+      {"frames", measureFrames},
+      {"draws", draws},
+      {"frames_in_flight", engine._framesInFlight},
+      {"cpu_frame_ms", percentiles(std::move(cpuMs))},
+      {"cpu_us_per_draw", draws > 0 ? cpuAvgMs * 1e3 / double(draws) : 0.},
+      {"gpu_ms", gpu},
+      {"fragment_invocations", engine._gpuProfiler->fragment_invocations()},
+      {"memory", memory_usage(engine)},
+  };
+  if (engine._dynamicResolution) {
+    const ResolutionScaleStats scale = engine._dynamicResolution->stats();
+    result["resolution_scale"] = {
+        {"current", scale.current}, {"min", scale.min}, {"avg", scale.avg}};
+  }
+  const CullingStats culling = engine._drawCulling->stats();
+  const double total = culling.drawnEarly + culling.drawnLate +
+                       culling.frustumCulled + culling.occluded;
+  result["culling"] = {
+      {"drawn_early", culling.drawnEarly},
+      {"drawn_late", culling.drawnLate},
+      {"frustum_culled", culling.frustumCulled},
+      {"occluded", culling.occluded},
+      {"occluded_ratio", total > 0. ? culling.occluded / total : 0.},
+      {"frustum_ratio", total > 0. ? culling.frustumCulled / total : 0.},
+  };
+  const RenderGraphStats& graph = engine._renderGraph->stats();
+  result["render_graph"] = {
+      {"passes", graph.passes},
+      {"culled_passes", graph.culledPasses},
+      {"barrier_batches", graph.barrierBatches},
+      {"image_barriers", graph.imageBarriers},
+      {"buffer_barriers", graph.bufferBarriers},
+      {"transient_bytes", graph.transientBytes},
+      {"transient_unaliased_bytes", graph.transientUnaliasedBytes},
+  };
+  // what async compute gains is the frame time saved against the serial
+  // scene, see add_savings. the frame scope also holds semaphore waits and
+  // gaps between submissions, so pass times can't be compared against it
+  if (graph.asyncPasses != 0) {
+    result["async_compute"] = {
+        {"batches", graph.batches},
+        {"async_passes", graph.asyncPasses},
+        {"queue_transfers", graph.queueTransfers},
+    };
+  }
+
+  // the most any frame wrote through its LinearAllocator, against the
+  // configured capacity
+  VkDeviceSize transientHighWater{0};
+  for (const FrameData& frame : engine._frames) {
+    transientHighWater =
+        std::max(transientHighWater, frame._transient->high_water());
+  }
+  result["frame_allocator"] = {
+      {"high_water_bytes", transientHighWater},
+      {"capacity_bytes", engine._frames.front()._transient->capacity()},
+  };
+  return result;
+}
+
+// adds the gpu frame time name saved against the scene without feature to
+// its section, if both ran
+void add_savings(json& scenes, const std::string& name,
+                 const std::string& without, const char* section,
+                 const char* feature) {
+  auto find = [&](const std::string& sceneName) {
+    return std::find_if(
+        scenes.begin(), scenes.end(),
+        [&](const json& s) { return s.at("name") == sceneName; });
+  };
+  auto with = find(name);
+  auto baseline = find(without);
+  if (with == scenes.end() || baseline == scenes.end() ||
+      !with->at("gpu_ms").contains("frame") ||
+      !baseline->at("gpu_ms").contains("frame")) {
+    return;
+  }
+
+  const double before = baseline->at("gpu_ms").at("frame").at("avg");
+  const double after = with->at("gpu_ms").at("frame").at("avg");
+  (*with)[section]["gpu_saved_ms"] = before - after;
+  (*with)[section]["gpu_saved_ratio"] =
+      before > 0. ? (before - after) / before : 0.;
+  fmt::print("{}: gpu frame {:.3f} ms, {:.3f} ms without {}\n", name, after,
+             before, feature);
+}
+
+json load_json(const std::string& path) {
+  std::ifstream file{path};
+  if (!file) {
+    throw std::runtime_error(fmt::format("failed to open {}", path));
+  }
+  return json::parse(file);
+}
+
+// relative change of a metric, positive means slower
+double change(const json& current, const json& baseline) {
+  const double before = baseline.get<double>();
+  if (before <= 0.) {
+    return 0.;
+  }
+  return (current.get<double>() - before) / before;
+}
+
+// returns the number of regressions beyond threshold
+uint32_t compare(const json& current, const json& baseline, double threshold) {
+  uint32_t regressions{0};
+
+  auto check = [&](const std::string& scene, const std::string& metric,
+                   const json& now, const json& before) {
+    if (now.is_null() || before.is_null()) {
+      return;
+    }
+    const double delta = change(now, before);
+    const bool regressed = delta > threshold;
+    regressions += regressed ? 1 : 0;
+    fmt::print("  {:<18} {:<22} {:9.3f} -> {:9.3f} ms {:+6.1f}%{}\n", scene,
+               metric, before.get<double>(), now.get<double>(), delta * 100.,
+               regressed ? "  REGRESSION" : "");
+  };
+
+  for (const json& scene : current.at("scenes")) {
+    const std::string name = scene.at("name");
+    const json& baselineScenes = baseline.at("scenes");
+    auto match = std::find_if(
+        baselineScenes.begin(), baselineScenes.end(),
+        [&](const json& s) { return s.at("name") == name; });
+    if (match == baselineScenes.end()) {
+      fmt::print("  {:<18} not in baseline\n", name);
+      continue;
+    }
+
+    for (const char* stat : {"p50", "p99"}) {
+      check(name, fmt::format("cpu frame {}", stat),
+            scene.at("cpu_frame_ms").value(stat, json{}),
+            match->at("cpu_frame_ms").value(stat, json{}));
+    }
+    for (const auto& [pass, stats] : scene.at("gpu_ms").items()) {
+      if (!match->at("gpu_ms").contains(pass)) {
+        continue;
+      }
+      check(name, fmt::format("gpu {} avg", pass), stats.at("avg"),
+            match->at("gpu_ms").at(pass).at("avg"));
+    }
+  }
+
+  return regressions;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  uint32_t warmupFrames{100};
+  uint32_t measureFrames{500};
+  std::vector<std::string> only;
+  std::string outPath;
+  std::string baselinePath;
+  std::string comparePath;
+  double threshold{.05};
+  std::string assetDir = EngineConfig{}.assetDir;
+
+  CLI::App app{"engine frame benchmark"};
+  app.add_option("--warmup", warmupFrames, "frames rendered before measuring");
+  app.add_option("--frames", measureFrames, "frames measured per scene")
+      ->check(CLI::PositiveNumber);
+  app.add_option("--scene", only, "only run these scenes");
+  app.add_option("--out", outPath, "write results as json");
+  app.add_option("--baseline", baselinePath, "results to compare against");
+  app.add_option("--compare", comparePath,
+                 "compare a results file instead of running")
+      ->needs("--baseline");
+  app.add_option("--threshold", threshold,
+                 "relative slowdown that counts as a regression");
+  app.add_option("--asset-dir", assetDir,
+                 "directory the models and textures are loaded from");
+  CLI11_PARSE(app, argc, argv);
+
+  json results;
+  if (!comparePath.empty()) {
+    results = load_json(comparePath);
+  } else {
+    results["warmup_frames"] = warmupFrames;
+    results["scenes"] = json::array();
+
+    for (const BenchScene& scene : scenes()) {
+      if (!only.empty() && std::ranges::find(only, scene.name) == only.end()) {
+        continue;
+      }
+      results["scenes"].push_back(
+          run_scene(scene, assetDir, warmupFrames, measureFrames));
+    }
+    for (const BenchScene& scene : scenes()) {
+      if (!scene.unculled.empty()) {
+        add_savings(results["scenes"], scene.name, scene.unculled, "culling",
+                    "culling");
+      }
+      if (!scene.serial.empty()) {
+        add_savings(results["scenes"], scene.name, scene.serial,
+                    "async_compute", "async compute");
+      }
+    }
+
+    if (outPath.empty()) {
+      fmt::print("{}\n", results.dump(2));
+    } else {
+      std::ofstream{outPath} << results.dump(2) << '\n';
+      fmt::print("wrote {}\n", outPath);
+    }
+  }
+
+  if (baselinePath.empty()) {
+    return 0;
+  }
+
+  fmt::print("compared to {}, threshold {:.1f}%:\n", baselinePath,
+             threshold * 100.);
+  uint32_t regressions = compare(results, load_json(baselinePath), threshold);
+  if (regressions != 0) {
+    fmt::print("{} regressions\n", regressions);
+    return 1;
+  }
+  return 0;
+}
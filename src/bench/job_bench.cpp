@@ -0,0 +1,156 @@
+// microbenchmarks for the engine job system: cost of spawning and running
+// jobs, parallel_for dispatch, and how quickly idle workers steal work. also
+// stress tests spawning onto a counter whose last job is finishing
+#include <fmt/format.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "job_system.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t ITERATIONS = 20;
+constexpr uint32_t JOBS_PER_ITERATION = 4000;
+
+double ns_per(Clock::duration duration, uint64_t count) {
+  return double(std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+                    .count()) /
+         double(count);
+}
+
+// every job is spawned by and waited on from the main thread, so this is
+// mostly push/pop/steal and counter overhead
+void bench_spawn(JobSystem& jobs) {
+  auto start = Clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    JobCounter counter;
+    for (uint32_t j = 0; j < JOBS_PER_ITERATION; j++) {
+      jobs.run(counter, []() {});
+    }
+    jobs.wait(counter);
+  }
+  fmt::print("spawn+wait empty job:      {:8.1f} ns/job\n",
+             ns_per(Clock::now() - start, ITERATIONS * JOBS_PER_ITERATION));
+}
+
+// all the jobs end up on one worker's deque, the others only get work by
+// stealing it
+void bench_steal(JobSystem& jobs) {
+  uint64_t stealsBefore = jobs.steal_count();
+  std::atomic<uint64_t> sink{0};
+
+  auto start = Clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    JobCounter counter;
+    for (uint32_t j = 0; j < JOBS_PER_ITERATION; j++) {
+      jobs.run(counter, [&sink]() {
+        // a little bit of work so thieves have a chance to show up
+        uint64_t value = 0;
+        for (uint32_t k = 0; k < 2000; k++) {
+          value += k * k;
+        }
+        sink.fetch_add(value, std::memory_order_relaxed);
+      });
+    }
+    jobs.wait(counter);
+  }
+  auto elapsed = Clock::now() - start;
+
+  uint64_t steals = jobs.steal_count() - stealsBefore;
+  fmt::print("spawn+wait 2k iter job:    {:8.1f} ns/job, {:.1f}% stolen\n",
+             ns_per(elapsed, ITERATIONS * JOBS_PER_ITERATION),
+             100. * double(steals) / double(ITERATIONS * JOBS_PER_ITERATION));
+}
+
+void bench_parallel_for(JobSystem& jobs) {
+  constexpr size_t COUNT = 1'000'000;
+  std::vector<float> values(COUNT, 1.F);
+
+  for (size_t grain : {64, 1024, 16384}) {
+    auto start = Clock::now();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+      jobs.parallel_for(COUNT, grain, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+          values[k] = values[k] * 0.5F + 1.F;
+        }
+      });
+    }
+    fmt::print("parallel_for grain {:5}:  {:8.2f} ns/element\n", grain,
+               ns_per(Clock::now() - start, ITERATIONS * COUNT));
+  }
+}
+
+// a chain of jobs where every one waits on the previous one's counter
+void bench_dependencies(JobSystem& jobs) {
+  constexpr uint32_t CHAIN_LENGTH = 1000;
+
+  auto start = Clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    std::vector<JobCounter> counters(CHAIN_LENGTH);
+    jobs.run(counters[0], []() {});
+    for (uint32_t j = 1; j < CHAIN_LENGTH; j++) {
+      jobs.run(counters[j], []() {}, &counters[j - 1]);
+    }
+    jobs.wait(counters.back());
+  }
+  fmt::print("dependent job chain:       {:8.1f} ns/job\n",
+             ns_per(Clock::now() - start, ITERATIONS * CHAIN_LENGTH));
+}
+
+// keeps spawning onto a counter while its earlier jobs finish, which is what
+// parallel_for does. wait() must not return before every job has run
+bool stress_spawn_while_finishing(JobSystem& jobs) {
+  constexpr uint32_t ROUNDS = 20000;
+  constexpr uint32_t JOBS_PER_ROUND = 8;
+
+  uint64_t early = 0;
+  for (uint32_t i = 0; i < ROUNDS; i++) {
+    std::atomic<uint32_t> ran{0};
+    JobCounter counter;
+    for (uint32_t j = 0; j < JOBS_PER_ROUND; j++) {
+      jobs.run(counter,
+               [&ran]() { ran.fetch_add(1, std::memory_order_relaxed); });
+      // give the job a chance to be stolen and finish before the next spawn
+      if (j % 2 == 0) {
+        std::this_thread::yield();
+      }
+    }
+    jobs.wait(counter);
+    if (ran.load(std::memory_order_relaxed) != JOBS_PER_ROUND) {
+      early++;
+      // the remaining jobs still reference ran and counter
+      while (ran.load(std::memory_order_relaxed) != JOBS_PER_ROUND) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  fmt::print("spawn while finishing:     {} of {} waits returned early\n",
+             early, ROUNDS);
+  return early == 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // worker count can be overridden to look at scaling
+  uint32_t workers = argc > 1 ? uint32_t(std::stoul(argv[1]))
+                              : std::thread::hardware_concurrency();
+
+  JobSystem jobs{workers};
+  fmt::print("job system with {} workers\n", jobs.worker_count());
+
+  bench_spawn(jobs);
+  bench_steal(jobs);
+  bench_parallel_for(jobs);
+  bench_dependencies(jobs);
+
+  return stress_spawn_while_finishing(jobs) ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+// cost of a cpu profiler scope against the 20 ns we allow for instrumenting
+// hot paths. a scope reads the timestamp twice, so where rdtsc is slow (it
+// traps in some virtual machines) the target can't be met and the bench says
+// by how much
+#include <fmt/format.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "cpu_profiler.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// fits into a thread buffer so the trace holds every scope of an iteration
+constexpr uint32_t SCOPES_PER_ITERATION = profiler::ThreadBuffer::CAPACITY / 2;
+constexpr uint32_t ITERATIONS = 50;
+
+constexpr double TARGET_NS = 20.;
+
+// keeps the loop bodies from being optimized away
+volatile uint32_t sink = 0;
+
+double ns_per(Clock::duration duration, uint64_t count) {
+  return double(std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+                    .count()) /
+         double(count);
+}
+
+void bench_empty_loop() {
+  auto start = Clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    for (uint32_t j = 0; j < SCOPES_PER_ITERATION; j++) {
+      sink = j;
+    }
+  }
+  fmt::print("empty loop:                {:8.2f} ns/iteration\n",
+             ns_per(Clock::now() - start, ITERATIONS * SCOPES_PER_ITERATION));
+}
+
+// the floor for a scope, which takes two of these
+double bench_timestamp() {
+  uint64_t sum = 0;
+
+  auto start = Clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    for (uint32_t j = 0; j < SCOPES_PER_ITERATION; j++) {
+      sum += profiler::now();
+    }
+  }
+  sink = static_cast<uint32_t>(sum);
+  const double ns =
+      ns_per(Clock::now() - start, ITERATIONS * SCOPES_PER_ITERATION);
+  fmt::print("profiler::now:             {:8.2f} ns/call\n", ns);
+  return ns;
+}
+
+double bench_scope() {
+  Clock::duration elapsed{};
+
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    profiler::clear();
+    auto start = Clock::now();
+    for (uint32_t j = 0; j < SCOPES_PER_ITERATION; j++) {
+      const profiler::Scope scope{"bench"};
+      sink = j;
+    }
+    elapsed += Clock::now() - start;
+  }
+  const double ns = ns_per(elapsed, ITERATIONS * SCOPES_PER_ITERATION);
+  fmt::print("profiler scope:            {:8.2f} ns/scope\n", ns);
+  return ns;
+}
+
+// every thread records into its own buffer, this should scale perfectly
+void bench_threads() {
+  const uint32_t threadCount = std::thread::hardware_concurrency();
+  profiler::clear();
+
+  auto start = Clock::now();
+  {
+    std::vector<std::jthread> threads;
+    for (uint32_t t = 0; t < threadCount; t++) {
+      threads.emplace_back([]() {
+        for (uint32_t j = 0; j < SCOPES_PER_ITERATION; j++) {
+          const profiler::Scope scope{"bench thread"};
+          sink = j;
+        }
+      });
+    }
+  }
+  fmt::print("profiler scope, {:2} threads: {:7.2f} ns/scope per thread\n",
+             threadCount,
+             ns_per(Clock::now() - start, SCOPES_PER_ITERATION));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bench_empty_loop();
+  const double timestamp = bench_timestamp();
+  const double scope = bench_scope();
+  bench_threads();
+
+  if (scope <= TARGET_NS) {
+    fmt::print("within the {:.0f} ns target\n", TARGET_NS);
+  } else {
+    fmt::print(
+        "missed the {:.0f} ns target by {:.2f} ns, {:.2f} ns of it are the "
+        "two timestamps\n",
+        TARGET_NS, scope - TARGET_NS, 2. * timestamp);
+  }
+
+  // optionally write the last run out, to check the trace loads
+  if (argc > 1) {
+    profiler::write_chrome_trace(argv[1]);
+  }
+
+  return 0;
+}
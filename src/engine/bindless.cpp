@@ -0,0 +1,346 @@
+#include "bindless.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+
+#include "helpers.hpp"
+
+namespace {
+
+VkPhysicalDeviceVulkan12Properties update_after_bind_limits(
+    VkPhysicalDevice gpu) {
+  VkPhysicalDeviceVulkan12Properties properties12{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES};
+  VkPhysicalDeviceProperties2 properties{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext = &properties12};
+  vkGetPhysicalDeviceProperties2(gpu, &properties);
+  return properties12;
+}
+
+// descriptor buffer layouts can't be update after bind, they are bound by the
+// regular limits
+uint32_t texture_limit(VkPhysicalDevice gpu, DescriptorBackend backend) {
+  if (backend == DescriptorBackend::Buffer) {
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(gpu, &properties);
+    return std::min({BindlessTable::MAX_TEXTURES,
+                     properties.limits.maxDescriptorSetSampledImages,
+                     properties.limits.maxPerStageDescriptorSampledImages});
+  }
+
+  const VkPhysicalDeviceVulkan12Properties limits =
+      update_after_bind_limits(gpu);
+  return std::min({BindlessTable::MAX_TEXTURES,
+                   limits.maxDescriptorSetUpdateAfterBindSampledImages,
+                   limits.maxPerStageDescriptorUpdateAfterBindSampledImages});
+}
+
+uint32_t sampler_limit(VkPhysicalDevice gpu, DescriptorBackend backend) {
+  if (backend == DescriptorBackend::Buffer) {
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(gpu, &properties);
+    return std::min({BindlessTable::MAX_SAMPLERS,
+                     properties.limits.maxDescriptorSetSamplers,
+                     properties.limits.maxPerStageDescriptorSamplers});
+  }
+
+  const VkPhysicalDeviceVulkan12Properties limits =
+      update_after_bind_limits(gpu);
+  return std::min({BindlessTable::MAX_SAMPLERS,
+                   limits.maxDescriptorSetUpdateAfterBindSamplers,
+                   limits.maxPerStageDescriptorUpdateAfterBindSamplers});
+}
+
+constexpr VkBufferUsageFlags DESCRIPTOR_BUFFER_USAGE =
+    VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT |
+    VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT |
+    VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+}  // namespace
+
+std::string_view to_string(DescriptorBackend backend) {
+  switch (backend) {
+    case DescriptorBackend::Pool:
+      return "descriptor pool";
+    case DescriptorBackend::Buffer:
+      return "descriptor buffer";
+  }
+  return "unknown";
+}
+
+uint32_t SlotAllocator::allocate() {
+  if (!_free.empty()) {
+    uint32_t slot = _free.back();
+    _free.pop_back();
+    return slot;
+  }
+  if (_next == _capacity) {
+    throw std::runtime_error("bindless table is full");
+  }
+  return _next++;
+}
+
+void SlotAllocator::release(uint32_t slot, uint64_t retireValue) {
+  _pending.push_back(PendingSlot{.slot = slot, .retireValue = retireValue});
+}
+
+void SlotAllocator::collect(uint64_t completedValue) {
+  // released in retire order, so the completed ones are a prefix
+  auto firstPending = std::ranges::find_if(
+      _pending, [completedValue](const PendingSlot &pending) {
+        return pending.retireValue > completedValue;
+      });
+
+  for (auto it = _pending.begin(); it != firstPending; ++it) {
+    _free.push_back(it->slot);
+  }
+  _pending.erase(_pending.begin(), firstPending);
+}
+
+BindlessTable::BindlessTable(VkDevice device, VkPhysicalDevice gpu,
+                             VmaAllocator allocator, DescriptorBackend backend)
+    : _device{device},
+      _allocator{allocator},
+      _backend{backend},
+      _textures{texture_limit(gpu, backend)},
+      _samplers{sampler_limit(gpu, backend)} {
+  create_layout();
+
+  if (_backend == DescriptorBackend::Buffer) {
+    create_buffer(gpu);
+  } else {
+    create_pool();
+  }
+}
+
+BindlessTable::~BindlessTable() {
+  if (_pool != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(_device, _pool, nullptr);
+  }
+  vkDestroyDescriptorSetLayout(_device, _layout, nullptr);
+}
+
+void BindlessTable::create_layout() {
+  std::array bindings{
+      VkDescriptorSetLayoutBinding{
+          .binding = TEXTURE_BINDING,
+          .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+          .descriptorCount = _textures.capacity(),
+          .stageFlags = VK_SHADER_STAGE_ALL,
+      },
+      VkDescriptorSetLayoutBinding{
+          .binding = SAMPLER_BINDING,
+          .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+          .descriptorCount = _samplers.capacity(),
+          .stageFlags = VK_SHADER_STAGE_ALL,
+      },
+  };
+
+  // empty slots are never read. for the pool, slots no frame in flight uses
+  // may be written while the set is bound. a descriptor buffer is plain
+  // memory and allows that anyway
+  VkDescriptorBindingFlags bindingFlag =
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+  VkDescriptorSetLayoutCreateFlags layoutFlags{};
+  if (_backend == DescriptorBackend::Buffer) {
+    layoutFlags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+  } else {
+    bindingFlag |= VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                   VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    layoutFlags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  }
+  std::array bindingFlags{bindingFlag, bindingFlag};
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{
+      .sType =
+          VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+  flagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+  flagsInfo.pBindingFlags = bindingFlags.data();
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = &flagsInfo;
+  layoutInfo.flags = layoutFlags;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  vk_check(
+      vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_layout));
+}
+
+void BindlessTable::create_pool() {
+  std::array poolSizes{
+      VkDescriptorPoolSize{
+          .type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+          .descriptorCount = _textures.capacity(),
+      },
+      VkDescriptorPoolSize{
+          .type = VK_DESCRIPTOR_TYPE_SAMPLER,
+          .descriptorCount = _samplers.capacity(),
+      },
+  };
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  poolInfo.maxSets = 1;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+
+  vk_check(vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_pool));
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = _pool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &_layout;
+
+  vk_check(vkAllocateDescriptorSets(_device, &allocInfo, &_set));
+}
+
+void BindlessTable::create_buffer(VkPhysicalDevice gpu) {
+  // volk loads these with the device, they stay null if the extension
+  // wasn't enabled
+  if (vkGetDescriptorSetLayoutSizeEXT == nullptr ||
+      vkGetDescriptorSetLayoutBindingOffsetEXT == nullptr ||
+      vkGetDescriptorEXT == nullptr ||
+      vkCmdBindDescriptorBuffersEXT == nullptr ||
+      vkCmdSetDescriptorBufferOffsetsEXT == nullptr) {
+    throw std::runtime_error("VK_EXT_descriptor_buffer functions missing");
+  }
+
+  VkPhysicalDeviceDescriptorBufferPropertiesEXT bufferProperties{
+      .sType =
+          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT};
+  VkPhysicalDeviceProperties2 properties{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext = &bufferProperties};
+  vkGetPhysicalDeviceProperties2(gpu, &properties);
+
+  _sampledImageSize = bufferProperties.sampledImageDescriptorSize;
+  _samplerSize = bufferProperties.samplerDescriptorSize;
+
+  VkDeviceSize layoutSize{};
+  vkGetDescriptorSetLayoutSizeEXT(_device, _layout, &layoutSize);
+  const VkDeviceSize alignment =
+      bufferProperties.descriptorBufferOffsetAlignment;
+  layoutSize = (layoutSize + alignment - 1) / alignment * alignment;
+
+  vkGetDescriptorSetLayoutBindingOffsetEXT(_device, _layout, TEXTURE_BINDING,
+                                           &_bindingOffsets[TEXTURE_BINDING]);
+  vkGetDescriptorSetLayoutBindingOffsetEXT(_device, _layout, SAMPLER_BINDING,
+                                           &_bindingOffsets[SAMPLER_BINDING]);
+
+  // written by the cpu, read by the gpu straight from host visible memory
+  _buffer.emplace(layoutSize, DESCRIPTOR_BUFFER_USAGE,
+                  VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::Other);
+
+  VkBufferDeviceAddressInfo addressInfo{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+      .buffer = _buffer->_buffer};
+  _bufferAddress = vkGetBufferDeviceAddress(_device, &addressInfo);
+}
+
+uint32_t BindlessTable::add_texture(VkImageView view) {
+  const uint32_t index = _textures.allocate();
+  set_texture(index, view);
+  return index;
+}
+
+void BindlessTable::set_texture(uint32_t index, VkImageView view) {
+  write(TEXTURE_BINDING, index, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        VkDescriptorImageInfo{
+            .imageView = view,
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        });
+}
+
+void BindlessTable::remove_texture(uint32_t index, uint64_t retireValue) {
+  _textures.release(index, retireValue);
+}
+
+uint32_t BindlessTable::add_sampler(VkSampler sampler) {
+  const uint32_t index = _samplers.allocate();
+  set_sampler(index, sampler);
+  return index;
+}
+
+void BindlessTable::set_sampler(uint32_t index, VkSampler sampler) {
+  write(SAMPLER_BINDING, index, VK_DESCRIPTOR_TYPE_SAMPLER,
+        VkDescriptorImageInfo{.sampler = sampler});
+}
+
+void BindlessTable::remove_sampler(uint32_t index, uint64_t retireValue) {
+  _samplers.release(index, retireValue);
+}
+
+void BindlessTable::collect(uint64_t completedValue) {
+  _textures.collect(completedValue);
+  _samplers.collect(completedValue);
+}
+
+void BindlessTable::bind(VkCommandBuffer cmd, VkPipelineLayout layout,
+                         VkPipelineBindPoint bindPoint) const {
+  if (_backend == DescriptorBackend::Pool) {
+    vkCmdBindDescriptorSets(cmd, bindPoint, layout, 0, 1, &_set, 0, nullptr);
+    return;
+  }
+
+  VkDescriptorBufferBindingInfoEXT bindingInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT};
+  bindingInfo.address = _bufferAddress;
+  bindingInfo.usage = DESCRIPTOR_BUFFER_USAGE;
+  vkCmdBindDescriptorBuffersEXT(cmd, 1, &bindingInfo);
+
+  const uint32_t bufferIndex = 0;
+  const VkDeviceSize offset = 0;
+  vkCmdSetDescriptorBufferOffsetsEXT(cmd, bindPoint, layout, 0, 1,
+                                     &bufferIndex, &offset);
+}
+
+VkPipelineCreateFlags BindlessTable::pipeline_flags() const {
+  return _backend == DescriptorBackend::Buffer
+             ? VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT
+             : 0;
+}
+
+void BindlessTable::write(uint32_t binding, uint32_t index,
+                          VkDescriptorType type,
+                          const VkDescriptorImageInfo &info) {
+  if (_backend == DescriptorBackend::Pool) {
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = _set;
+    descriptorWrite.dstBinding = binding;
+    descriptorWrite.dstArrayElement = index;
+    descriptorWrite.descriptorType = type;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &info;
+
+    vkUpdateDescriptorSets(_device, 1, &descriptorWrite, 0, nullptr);
+    return;
+  }
+
+  VkDescriptorGetInfoEXT getInfo{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT};
+  getInfo.type = type;
+  size_t size{};
+  if (type == VK_DESCRIPTOR_TYPE_SAMPLER) {
+    getInfo.data.pSampler = &info.sampler;
+    size = _samplerSize;
+  } else {
+    getInfo.data.pSampledImage = &info;
+    size = _sampledImageSize;
+  }
+
+  const VkDeviceSize offset = _bindingOffsets[binding] + index * size;
+  auto *mapped = static_cast<std::byte *>(_buffer->_info.pMappedData);
+  vkGetDescriptorEXT(_device, &getInfo, size, mapped + offset);
+
+  // no-op on coherent memory
+  vk_check(
+      vmaFlushAllocation(_allocator, _buffer->_allocation, offset, size));
+}
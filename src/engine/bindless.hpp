@@ -0,0 +1,144 @@
+#pragma once
+
+#include <vk_mem_alloc.h>
+#include <volk.h>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "struct.hpp"
+
+// hands out array slots. released slots are only reused once the gpu is done
+// with the frame that released them, until then shaders may still read them
+class SlotAllocator {
+ public:
+  explicit SlotAllocator(uint32_t capacity) : _capacity{capacity} {}
+
+  // throws when every slot is taken
+  uint32_t allocate();
+
+  // slot can be reused once retireValue is completed, see RetireQueue
+  void release(uint32_t slot, uint64_t retireValue);
+
+  // makes slots released with a value <= completedValue allocatable again
+  void collect(uint64_t completedValue);
+
+  [[nodiscard]] uint32_t capacity() const { return _capacity; }
+  // slots that are allocated or waiting to be reused
+  [[nodiscard]] uint32_t used() const {
+    return _next - static_cast<uint32_t>(_free.size());
+  }
+
+ private:
+  struct PendingSlot {
+    uint32_t slot;
+    uint64_t retireValue;
+  };
+
+  uint32_t _capacity;
+  // slots below this were handed out at least once
+  uint32_t _next{0};
+  std::vector<uint32_t> _free;
+  // in retire order
+  std::vector<PendingSlot> _pending;
+};
+
+// where the descriptors of the bindless table live
+enum class DescriptorBackend : uint8_t {
+  // a descriptor set from a pool, written with vkUpdateDescriptorSets
+  Pool,
+  // a host visible VK_EXT_descriptor_buffer, written with vkGetDescriptorEXT
+  // and bound by offset
+  Buffer,
+};
+
+std::string_view to_string(DescriptorBackend backend);
+
+// one global descriptor set holding every sampled image and sampler, indexed
+// from shaders with the indices handed out here. the arrays are partially
+// bound, and slots no frame in flight uses can be written while the table is
+// bound (update after bind for the pool, plain memory for the buffer), so it
+// is bound once per command buffer.
+//
+// set 0, binding 0: texture2D textures[], binding 1: sampler samplers[]
+class BindlessTable {
+ public:
+  static constexpr uint32_t TEXTURE_BINDING = 0;
+  static constexpr uint32_t SAMPLER_BINDING = 1;
+
+  // upper bounds, clamped to the device limits
+  static constexpr uint32_t MAX_TEXTURES = 16384;
+  static constexpr uint32_t MAX_SAMPLERS = 64;
+
+  // the buffer backend needs VK_EXT_descriptor_buffer and its feature enabled
+  BindlessTable(VkDevice device, VkPhysicalDevice gpu, VmaAllocator allocator,
+                DescriptorBackend backend);
+  BindlessTable(const BindlessTable &) = delete;
+  BindlessTable(BindlessTable &&) = delete;
+  BindlessTable &operator=(const BindlessTable &) = delete;
+  BindlessTable &operator=(BindlessTable &&) = delete;
+  ~BindlessTable();
+
+  // view has to be in SHADER_READ_ONLY_OPTIMAL when sampled
+  uint32_t add_texture(VkImageView view);
+  // points an allocated slot at another view. no frame in flight may use it
+  void set_texture(uint32_t index, VkImageView view);
+  // the view must stay alive until retireValue is completed, retire it with
+  // the same value
+  void remove_texture(uint32_t index, uint64_t retireValue);
+
+  uint32_t add_sampler(VkSampler sampler);
+  void set_sampler(uint32_t index, VkSampler sampler);
+  void remove_sampler(uint32_t index, uint64_t retireValue);
+
+  // once per frame, makes removed slots reusable
+  void collect(uint64_t completedValue);
+
+  // binds the table as set 0 of layout
+  void bind(
+      VkCommandBuffer cmd, VkPipelineLayout layout,
+      VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS) const;
+
+  [[nodiscard]] VkDescriptorSetLayout layout() const { return _layout; }
+  // pipelines using layout() have to be created with these
+  [[nodiscard]] VkPipelineCreateFlags pipeline_flags() const;
+  [[nodiscard]] DescriptorBackend backend() const { return _backend; }
+
+  [[nodiscard]] uint32_t texture_capacity() const {
+    return _textures.capacity();
+  }
+  [[nodiscard]] uint32_t sampler_capacity() const {
+    return _samplers.capacity();
+  }
+
+ private:
+  void create_layout();
+  void create_pool();
+  void create_buffer(VkPhysicalDevice gpu);
+
+  void write(uint32_t binding, uint32_t index, VkDescriptorType type,
+             const VkDescriptorImageInfo &info);
+
+  VkDevice _device;
+  VmaAllocator _allocator;
+  DescriptorBackend _backend;
+  VkDescriptorSetLayout _layout{};
+
+  // pool backend
+  VkDescriptorPool _pool{};
+  VkDescriptorSet _set{};
+
+  // buffer backend
+  std::optional<AllocatedBuffer> _buffer;
+  VkDeviceAddress _bufferAddress{};
+  // where the arrays start in the buffer, by binding
+  std::array<VkDeviceSize, 2> _bindingOffsets{};
+  size_t _sampledImageSize{};
+  size_t _samplerSize{};
+
+  SlotAllocator _textures;
+  SlotAllocator _samplers;
+};
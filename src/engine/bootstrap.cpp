@@ -4,20 +4,20 @@
 
 #include "vk_mem_alloc.h"
 
-vkb::Device select_device(vkb::Instance& vkb_inst, vk::SurfaceKHR& surface) {
+vkb::Device select_device(vkb::Instance& vkb_inst, VkSurfaceKHR surface) {
   VkPhysicalDeviceVulkan13Features features13{
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
-      .synchronization2 = vk::True,
-      .dynamicRendering = vk::True,
+      .synchronization2 = VK_TRUE,
+      .dynamicRendering = VK_TRUE,
   };
 
   VkPhysicalDeviceVulkan12Features features12{
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
-  features12.bufferDeviceAddress = vk::True;
-  features12.descriptorIndexing = vk::True;
+  features12.bufferDeviceAddress = VK_TRUE;
+  features12.descriptorIndexing = VK_TRUE;
 
   VkPhysicalDeviceFeatures features{};
-  features.samplerAnisotropy = vk::True;
+  features.samplerAnisotropy = VK_TRUE;
 
   vkb::PhysicalDeviceSelector selector{vkb_inst};
   vkb::PhysicalDevice physicalDevice = selector.set_minimum_version(1, 3)
@@ -0,0 +1,81 @@
+#include "camera.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "vulkan/util.hpp"
+
+Camera::Camera(glm::vec3 position, glm::vec3 target, glm::vec3 up)
+    : _position{position}, _target{target}, _up{up} {}
+
+void Camera::look_at(glm::vec3 position, glm::vec3 target, glm::vec3 up) {
+  if (position == _position && target == _target && up == _up) {
+    return;
+  }
+  _position = position;
+  _target = target;
+  _up = up;
+  _dirty = true;
+}
+
+void Camera::set_fov(float fovy) {
+  if (fovy != _fovy) {
+    _fovy = fovy;
+    _dirty = true;
+  }
+}
+
+void Camera::set_aspect(float aspect) {
+  if (aspect != _aspect) {
+    _aspect = aspect;
+    _dirty = true;
+  }
+}
+
+const glm::mat4 &Camera::view() const {
+  update();
+  return _view;
+}
+
+const glm::mat4 &Camera::projection() const {
+  update();
+  return _projection;
+}
+
+const glm::mat4 &Camera::view_projection() const {
+  update();
+  return _data.viewProj;
+}
+
+const CameraData &Camera::data() const {
+  update();
+  return _data;
+}
+
+void Camera::update() const {
+  if (!_dirty) {
+    return;
+  }
+  _dirty = false;
+
+  _view = glm::lookAt(_position, _target, _up);
+  _projection = vkutil::perspective_reverse_z(_fovy, _aspect, _zNear);
+  // vulkan's clip space y points down
+  _projection[1][1] *= -1;
+
+  const glm::mat4 m = _projection * _view;
+  _data.viewProj = m;
+  _data.position = glm::vec4(_position, 1.F);
+
+  // the clip space inequalities -w <= x <= w, -w <= y <= w and z <= w as
+  // planes on the world space position, see Gribb and Hartmann
+  auto row = [&](int i) {
+    return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+  };
+  const std::array<glm::vec4, FRUSTUM_PLANES> planes{
+      row(3) + row(0), row(3) - row(0), row(3) + row(1),
+      row(3) - row(1), row(3) - row(2),
+  };
+  for (size_t i = 0; i < FRUSTUM_PLANES; i++) {
+    _data.frustum[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+  }
+}
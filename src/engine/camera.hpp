@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// left, right, bottom, top and near. the projection has no far plane
+constexpr size_t FRUSTUM_PLANES = 5;
+
+// what the shaders know about the camera, written once per frame. std430
+// layout, keep in sync with colored_triangle.vert, colored_triangle_pulled.vert
+// and cull.comp
+struct CameraData {
+  glm::mat4 viewProj;
+  // world space, xyz the normal pointing inside and w the distance, so a
+  // point p is in front of a plane if dot(plane.xyz, p) + plane.w >= 0
+  std::array<glm::vec4, FRUSTUM_PLANES> frustum;
+  // w unused
+  glm::vec4 position;
+};
+static_assert(sizeof(CameraData) == 160);
+
+// a perspective camera looking at a target. the matrices are only
+// recomputed after something changed, not every time they are read
+class Camera {
+ public:
+  Camera(glm::vec3 position, glm::vec3 target, glm::vec3 up);
+
+  void look_at(glm::vec3 position, glm::vec3 target, glm::vec3 up);
+  // fovy in radians
+  void set_fov(float fovy);
+  void set_aspect(float aspect);
+
+  [[nodiscard]] const glm::mat4 &view() const;
+  [[nodiscard]] const glm::mat4 &projection() const;
+  [[nodiscard]] const glm::mat4 &view_projection() const;
+  [[nodiscard]] const CameraData &data() const;
+
+ private:
+  void update() const;
+
+  glm::vec3 _position;
+  glm::vec3 _target;
+  glm::vec3 _up;
+  float _fovy{glm::radians(45.F)};
+  float _aspect{1.F};
+  float _zNear{.1F};
+
+  // cached, recomputed on the first read after a change
+  mutable bool _dirty{true};
+  mutable glm::mat4 _view{1.F};
+  mutable glm::mat4 _projection{1.F};
+  mutable CameraData _data{};
+};
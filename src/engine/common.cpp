@@ -5,7 +5,7 @@
 #include "bootstrap.hpp"
 #include "engine.hpp"
 
-Engine& get_engine() {
-  static auto engine = std::make_unique<Engine>();
+Engine& get_engine(const EngineConfig& config) {
+  static auto engine = std::make_unique<Engine>(config);
   return *engine;
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "engine_config.hpp"
+
 class Engine;
-/// get singleton engine
-Engine& get_engine();
+/// get singleton engine. config is only used by the call that creates it
+Engine& get_engine(const EngineConfig& config = {});
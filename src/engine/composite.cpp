@@ -0,0 +1,150 @@
+#include "composite.hpp"
+
+#include <array>
+#include <shaders/composite_comp.hpp>
+#include <stdexcept>
+#include <utility>
+
+#include "helpers.hpp"
+#include "vulkan/util.hpp"
+
+namespace {
+
+// layout of the push constant block in composite.comp
+struct CompositePushConstants {
+  int32_t sourceWidth;
+  int32_t sourceHeight;
+  int32_t targetWidth;
+  int32_t targetHeight;
+  float sharpness;
+};
+
+constexpr uint32_t SOURCE_BINDING = 0;
+constexpr uint32_t TARGET_BINDING = 1;
+
+uint32_t group_count(uint32_t size) {
+  return (size + Composite::TILE_SIZE - 1) / Composite::TILE_SIZE;
+}
+
+}  // namespace
+
+Composite::Composite(VkDevice device, uint32_t frameCount)
+    : _device{device}, _sets(frameCount) {
+  std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+  for (uint32_t binding : {SOURCE_BINDING, TARGET_BINDING}) {
+    bindings.at(binding) = VkDescriptorSetLayoutBinding{
+        .binding = binding,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+    };
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+  vk_check(
+      vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_setLayout));
+
+  VkDescriptorPoolSize poolSize{
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+      .descriptorCount = frameCount * static_cast<uint32_t>(bindings.size())};
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = frameCount;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes = &poolSize;
+  vk_check(vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_pool));
+
+  const std::vector<VkDescriptorSetLayout> layouts(frameCount, _setLayout);
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = _pool;
+  allocInfo.descriptorSetCount = frameCount;
+  allocInfo.pSetLayouts = layouts.data();
+  vk_check(vkAllocateDescriptorSets(_device, &allocInfo, _sets.data()));
+
+  VkPushConstantRange pushConstant{};
+  pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstant.size = sizeof(CompositePushConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &_setLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+  vk_check(vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr,
+                                  &_layout));
+
+  VkShaderModule shader{};
+  if (!vkutil::load_shader_module(spirv::composite_comp, _device, &shader)) {
+    throw std::runtime_error(
+        "Error when building the composite shader module");
+  }
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shader;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = _layout;
+  vk_check(vkCreateComputePipelines(_device, VK_NULL_HANDLE, 1, &pipelineInfo,
+                                    nullptr, &_pipeline));
+
+  vkDestroyShaderModule(_device, shader, nullptr);
+}
+
+Composite::~Composite() {
+  vkDestroyPipeline(_device, _pipeline, nullptr);
+  vkDestroyPipelineLayout(_device, _layout, nullptr);
+  // frees the sets too
+  vkDestroyDescriptorPool(_device, _pool, nullptr);
+  vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+}
+
+void Composite::record(VkCommandBuffer cmd, uint32_t frameSlot,
+                       VkImageView source, VkExtent2D sourceExtent,
+                       VkImageView target, VkExtent2D targetExtent) {
+  VkDescriptorSet set = _sets.at(frameSlot);
+
+  const VkDescriptorImageInfo sourceInfo{
+      .imageView = source, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+  const VkDescriptorImageInfo targetInfo{
+      .imageView = target, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+
+  std::array<VkWriteDescriptorSet, 2> writes{};
+  for (auto [binding, info] : {std::pair{SOURCE_BINDING, &sourceInfo},
+                               std::pair{TARGET_BINDING, &targetInfo}}) {
+    writes.at(binding) = VkWriteDescriptorSet{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set,
+        .dstBinding = binding,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        .pImageInfo = info,
+    };
+  }
+  vkUpdateDescriptorSets(_device, static_cast<uint32_t>(writes.size()),
+                         writes.data(), 0, nullptr);
+
+  const CompositePushConstants constants{
+      .sourceWidth = static_cast<int32_t>(sourceExtent.width),
+      .sourceHeight = static_cast<int32_t>(sourceExtent.height),
+      .targetWidth = static_cast<int32_t>(targetExtent.width),
+      .targetHeight = static_cast<int32_t>(targetExtent.height),
+      .sharpness = _sharpness,
+  };
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _layout, 0, 1,
+                          &set, 0, nullptr);
+  vkCmdPushConstants(cmd, _layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(constants), &constants);
+  vkCmdDispatch(cmd, group_count(targetExtent.width),
+                group_count(targetExtent.height), 1);
+}
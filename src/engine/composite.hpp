@@ -0,0 +1,46 @@
+#pragma once
+
+#include <volk.h>
+
+#include <cstdint>
+#include <vector>
+
+// the last pass of a frame: tonemaps the hdr draw image and scales it to the
+// output in one compute dispatch, fsr1 style edge adaptive upsampling then
+// contrast adaptive sharpening, see shaders/composite.comp. it writes the
+// output as a storage image, so the swapchain never goes through a transfer
+// layout
+class Composite {
+ public:
+  // workgroup size in both dimensions, keep in sync with composite.comp
+  static constexpr uint32_t TILE_SIZE = 16;
+
+  // frameCount descriptor sets are kept, one per frame in flight
+  Composite(VkDevice device, uint32_t frameCount);
+  Composite(const Composite &) = delete;
+  Composite(Composite &&) = delete;
+  Composite &operator=(const Composite &) = delete;
+  Composite &operator=(Composite &&) = delete;
+  ~Composite();
+
+  // reads the top left sourceExtent of source and covers all of target. both
+  // have to be in GENERAL, target a unorm storage image, written srgb encoded
+  // without a format so shaderStorageImageWriteWithoutFormat has to be
+  // enabled. the slot's previous frame has to be complete
+  void record(VkCommandBuffer cmd, uint32_t frameSlot, VkImageView source,
+              VkExtent2D sourceExtent, VkImageView target,
+              VkExtent2D targetExtent);
+
+  // rcas strength in [0, 1], 0 disables sharpening
+  void set_sharpness(float sharpness) { _sharpness = sharpness; }
+
+ private:
+  VkDevice _device;
+  VkDescriptorSetLayout _setLayout{};
+  VkDescriptorPool _pool{};
+  // rewritten every frame since the swapchain image changes
+  std::vector<VkDescriptorSet> _sets;
+  VkPipelineLayout _layout{};
+  VkPipeline _pipeline{};
+  float _sharpness{.8F};
+};
@@ -0,0 +1,147 @@
+#include "cpu_profiler.hpp"
+
+#include <fmt/format.h>
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace profiler {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Registry {
+  std::mutex mutex;
+  // kept after their threads exit so their events still end up in the trace
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+  // reference point for converting ticks to time
+  uint64_t startTicks{now()};
+  Clock::time_point startTime{Clock::now()};
+};
+
+Registry &registry() {
+  static Registry instance;
+  return instance;
+}
+
+// measures the tick rate against the steady clock over the time since the
+// registry was created
+double ticks_per_microsecond(Registry &reg) {
+  constexpr auto MIN_CALIBRATION = std::chrono::milliseconds(10);
+  if (Clock::now() - reg.startTime < MIN_CALIBRATION) {
+    std::this_thread::sleep_for(MIN_CALIBRATION);
+  }
+
+  const uint64_t ticks = now() - reg.startTicks;
+  const std::chrono::duration<double, std::micro> elapsed =
+      Clock::now() - reg.startTime;
+  return static_cast<double>(ticks) / elapsed.count();
+}
+
+// scope names are usually literals, but nothing stops one from holding a
+// quote or a path with backslashes, which would break the json
+void escape_json(std::string_view text, std::string &out) {
+  out.clear();
+  for (const char c : text) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          out += fmt::format("\\u{:04x}", static_cast<unsigned char>(c));
+        } else {
+          out += c;
+        }
+    }
+  }
+}
+
+}  // namespace
+
+ThreadBuffer &register_thread() {
+  Registry &reg = registry();
+  std::scoped_lock lock{reg.mutex};
+
+  auto &buffer = reg.buffers.emplace_back(std::make_unique<ThreadBuffer>());
+  buffer->threadId = static_cast<uint32_t>(reg.buffers.size() - 1);
+  tls_buffer = buffer.get();
+  return *buffer;
+}
+
+bool write_chrome_trace(std::string_view path) {
+  Registry &reg = registry();
+  std::scoped_lock lock{reg.mutex};
+
+  std::FILE *file = std::fopen(std::string(path).c_str(), "w");
+  if (file == nullptr) {
+    fmt::print("failed to open trace file {}\n", path);
+    return false;
+  }
+
+  const double tickRate = ticks_per_microsecond(reg);
+  auto to_us = [&](uint64_t ticks) {
+    return static_cast<double>(ticks - reg.startTicks) / tickRate;
+  };
+
+  size_t eventCount{0};
+  uint64_t overwrittenCount{0};
+  bool first = true;
+  std::string name;
+
+  fmt::print(file, "{{\"traceEvents\":[\n");
+  for (const auto &buffer : reg.buffers) {
+    const uint64_t written = buffer->written.load(std::memory_order_acquire);
+    const uint64_t firstKept =
+        written > ThreadBuffer::CAPACITY ? written - ThreadBuffer::CAPACITY : 0;
+    overwrittenCount += firstKept;
+
+    fmt::print(file,
+               "{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+               "\"tid\":{},\"args\":{{\"name\":\"thread {}\"}}}}",
+               first ? "" : ",\n", buffer->threadId, buffer->threadId);
+    first = false;
+
+    for (uint64_t i = firstKept; i < written; i++) {
+      const Event &event = buffer->events[i & ThreadBuffer::MASK];
+      escape_json(event.name, name);
+      fmt::print(file,
+                 ",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},"
+                 "\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                 name, buffer->threadId, to_us(event.begin),
+                 static_cast<double>(event.end - event.begin) / tickRate);
+    }
+    eventCount += written - firstKept;
+  }
+  fmt::print(file, "\n]}}\n");
+
+  const bool ok = std::ferror(file) == 0;
+  std::fclose(file);
+
+  fmt::print("wrote {} cpu profiler events to {}", eventCount, path);
+  if (overwrittenCount != 0) {
+    fmt::print(", {} older ones were overwritten", overwrittenCount);
+  }
+  fmt::print("\n");
+  return ok;
+}
+
+void clear() {
+  Registry &reg = registry();
+  std::scoped_lock lock{reg.mutex};
+
+  for (const auto &buffer : reg.buffers) {
+    buffer->written.store(0, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace profiler
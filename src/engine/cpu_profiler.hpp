@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#endif
+
+// instrumented cpu scopes, exported as chrome trace events (load the file in
+// chrome://tracing or ui.perfetto.dev).
+//
+//   void Engine::draw() {
+//     PROFILE_SCOPE("draw");
+//
+// every thread appends to its own fixed size ring without locking, which
+// keeps its newest events. scopes compile to nothing unless
+// ENGINE_CPU_PROFILER is defined
+namespace profiler {
+
+struct Event {
+  // has to outlive the trace, use string literals
+  const char *name;
+  uint64_t begin;
+  uint64_t end;
+};
+
+// written by its thread only. once full, new events overwrite the oldest
+// ones, so a trace dumped at any point shows the latest frames. the number
+// written is published after the event, so write_chrome_trace knows which
+// slots hold complete events
+struct ThreadBuffer {
+  static constexpr uint32_t CAPACITY = 1U << 16U;
+  static constexpr uint32_t MASK = CAPACITY - 1;
+  static_assert((CAPACITY & MASK) == 0, "capacity must be a power of two");
+
+  std::array<Event, CAPACITY> events;
+  // events recorded since the last clear, the newest CAPACITY of them are
+  // kept
+  std::atomic<uint64_t> written{0};
+  uint32_t threadId{0};
+};
+
+// raw timestamp in ticks. the tsc where available since it's a fraction of
+// the cost of a clock call, converted to time when the trace is written
+inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+  return __rdtsc();
+#else
+  return static_cast<uint64_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// registers the calling thread on first use
+ThreadBuffer &register_thread();
+
+inline thread_local ThreadBuffer *tls_buffer = nullptr;
+
+inline void record(const char *name, uint64_t begin, uint64_t end) {
+  ThreadBuffer *buffer = tls_buffer;
+  if (buffer == nullptr) [[unlikely]] {
+    buffer = &register_thread();
+  }
+
+  const uint64_t index = buffer->written.load(std::memory_order_relaxed);
+  buffer->events[index & ThreadBuffer::MASK] = Event{name, begin, end};
+  buffer->written.store(index + 1, std::memory_order_release);
+}
+
+// writes the newest events of every thread as chrome trace event json. call
+// it while no other thread is recording, e.g. between frames, or that
+// thread's oldest events may be torn. returns false if the file couldn't be
+// written
+bool write_chrome_trace(std::string_view path);
+
+// drops all recorded events. only call while no other thread is recording,
+// e.g. between frames
+void clear();
+
+class Scope {
+ public:
+  explicit Scope(const char *name) : _name{name}, _begin{now()} {}
+  Scope(const Scope &) = delete;
+  Scope(Scope &&) = delete;
+  Scope &operator=(const Scope &) = delete;
+  Scope &operator=(Scope &&) = delete;
+  ~Scope() { record(_name, _begin, now()); }
+
+ private:
+  const char *_name;
+  uint64_t _begin;
+};
+
+}  // namespace profiler
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef ENGINE_CPU_PROFILER
+#define PROFILE_SCOPE(name) \
+  const profiler::Scope PROFILE_CONCAT(profileScope, __LINE__) { name }
+#else
+#define PROFILE_SCOPE(name) static_cast<void>(0)
+#endif
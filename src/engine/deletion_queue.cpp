@@ -0,0 +1,125 @@
+#include "deletion_queue.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include "cpu_profiler.hpp"
+
+namespace {
+
+template <typename T>
+T handle_cast(uint64_t handle) {
+  return reinterpret_cast<T>(handle);
+}
+
+}  // namespace
+
+RetireQueue::RetireQueue(VkDevice device, VmaAllocator allocator,
+                         size_t capacity)
+    : _device{device},
+      _allocator{allocator},
+      _ring(std::bit_ceil(std::max<size_t>(capacity, 1))) {}
+
+void RetireQueue::push(const RetiredResource &resource) {
+  assert(resource.retireValue >= _lastValue &&
+         "resources have to be retired in timeline order");
+  _lastValue = resource.retireValue;
+
+  if (size() == _ring.size()) [[unlikely]] {
+    grow();
+  }
+
+  _ring[_tail & (_ring.size() - 1)] = resource;
+  _tail++;
+}
+
+void RetireQueue::grow() {
+  std::vector<RetiredResource> ring(_ring.size() * 2);
+  for (size_t i = _head; i < _tail; i++) {
+    ring[i - _head] = _ring[i & (_ring.size() - 1)];
+  }
+
+  _tail -= _head;
+  _head = 0;
+  _ring = std::move(ring);
+}
+
+size_t RetireQueue::collect(uint64_t completedValue) {
+  PROFILE_SCOPE("RetireQueue::collect");
+
+  const size_t mask = _ring.size() - 1;
+  const size_t start = _head;
+  while (_head != _tail && _ring[_head & mask].retireValue <= completedValue) {
+    destroy(_ring[_head & mask]);
+    _head++;
+  }
+  return _head - start;
+}
+
+void RetireQueue::flush() {
+  const size_t mask = _ring.size() - 1;
+  for (; _head != _tail; _head++) {
+    destroy(_ring[_head & mask]);
+  }
+}
+
+void RetireQueue::destroy(const RetiredResource &resource) {
+  switch (resource.type) {
+    case ResourceType::Buffer:
+      vmaDestroyBuffer(_allocator, handle_cast<VkBuffer>(resource.handle),
+                       resource.allocation);
+      break;
+    case ResourceType::Image:
+      vmaDestroyImage(_allocator, handle_cast<VkImage>(resource.handle),
+                      resource.allocation);
+      break;
+    case ResourceType::ImageView:
+      vkDestroyImageView(_device, handle_cast<VkImageView>(resource.handle),
+                         nullptr);
+      break;
+    case ResourceType::Sampler:
+      vkDestroySampler(_device, handle_cast<VkSampler>(resource.handle),
+                       nullptr);
+      break;
+    case ResourceType::Pipeline:
+      vkDestroyPipeline(_device, handle_cast<VkPipeline>(resource.handle),
+                        nullptr);
+      break;
+    case ResourceType::PipelineLayout:
+      vkDestroyPipelineLayout(
+          _device, handle_cast<VkPipelineLayout>(resource.handle), nullptr);
+      break;
+    case ResourceType::DescriptorSetLayout:
+      vkDestroyDescriptorSetLayout(
+          _device, handle_cast<VkDescriptorSetLayout>(resource.handle),
+          nullptr);
+      break;
+    case ResourceType::DescriptorPool:
+      vkDestroyDescriptorPool(
+          _device, handle_cast<VkDescriptorPool>(resource.handle), nullptr);
+      break;
+    case ResourceType::ShaderModule:
+      vkDestroyShaderModule(
+          _device, handle_cast<VkShaderModule>(resource.handle), nullptr);
+      break;
+    case ResourceType::CommandPool:
+      vkDestroyCommandPool(_device,
+                           handle_cast<VkCommandPool>(resource.handle), nullptr);
+      break;
+    case ResourceType::Semaphore:
+      vkDestroySemaphore(_device, handle_cast<VkSemaphore>(resource.handle),
+                         nullptr);
+      break;
+    case ResourceType::Fence:
+      vkDestroyFence(_device, handle_cast<VkFence>(resource.handle), nullptr);
+      break;
+    case ResourceType::QueryPool:
+      vkDestroyQueryPool(_device, handle_cast<VkQueryPool>(resource.handle),
+                         nullptr);
+      break;
+    case ResourceType::Swapchain:
+      vkDestroySwapchainKHR(
+          _device, handle_cast<VkSwapchainKHR>(resource.handle), nullptr);
+      break;
+  }
+}
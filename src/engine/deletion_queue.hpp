@@ -0,0 +1,129 @@
+#pragma once
+
+#include <vk_mem_alloc.h>
+#include <volk.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+enum class ResourceType : uint8_t {
+  Buffer,
+  Image,
+  ImageView,
+  Sampler,
+  Pipeline,
+  PipelineLayout,
+  DescriptorSetLayout,
+  DescriptorPool,
+  ShaderModule,
+  CommandPool,
+  Semaphore,
+  Fence,
+  QueryPool,
+  Swapchain,
+};
+
+// maps a vulkan handle type to its ResourceType
+template <typename T>
+constexpr ResourceType resource_type() {
+  if constexpr (std::is_same_v<T, VkBuffer>) {
+    return ResourceType::Buffer;
+  } else if constexpr (std::is_same_v<T, VkImage>) {
+    return ResourceType::Image;
+  } else if constexpr (std::is_same_v<T, VkImageView>) {
+    return ResourceType::ImageView;
+  } else if constexpr (std::is_same_v<T, VkSampler>) {
+    return ResourceType::Sampler;
+  } else if constexpr (std::is_same_v<T, VkPipeline>) {
+    return ResourceType::Pipeline;
+  } else if constexpr (std::is_same_v<T, VkPipelineLayout>) {
+    return ResourceType::PipelineLayout;
+  } else if constexpr (std::is_same_v<T, VkDescriptorSetLayout>) {
+    return ResourceType::DescriptorSetLayout;
+  } else if constexpr (std::is_same_v<T, VkDescriptorPool>) {
+    return ResourceType::DescriptorPool;
+  } else if constexpr (std::is_same_v<T, VkShaderModule>) {
+    return ResourceType::ShaderModule;
+  } else if constexpr (std::is_same_v<T, VkCommandPool>) {
+    return ResourceType::CommandPool;
+  } else if constexpr (std::is_same_v<T, VkSemaphore>) {
+    return ResourceType::Semaphore;
+  } else if constexpr (std::is_same_v<T, VkFence>) {
+    return ResourceType::Fence;
+  } else if constexpr (std::is_same_v<T, VkQueryPool>) {
+    return ResourceType::QueryPool;
+  } else if constexpr (std::is_same_v<T, VkSwapchainKHR>) {
+    return ResourceType::Swapchain;
+  } else {
+    static_assert(!sizeof(T), "no ResourceType for this handle");
+  }
+}
+
+struct RetiredResource {
+  uint64_t handle;
+  // only for buffers and images
+  VmaAllocation allocation;
+  // destroyed once the gpu has completed this value
+  uint64_t retireValue;
+  ResourceType type;
+};
+
+// destroys vulkan objects once the gpu is done with them. entries are plain
+// structs in a ring that only grows when it overflows, so retiring and
+// destroying don't allocate.
+//
+// values are timeline values: work submitted with value v may still use
+// anything retired with a value <= v. they have to be retired in
+// non-decreasing order
+class RetireQueue {
+ public:
+  static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+  RetireQueue(VkDevice device, VmaAllocator allocator,
+              size_t capacity = DEFAULT_CAPACITY);
+  RetireQueue(const RetireQueue &) = delete;
+  RetireQueue(RetireQueue &&) = delete;
+  RetireQueue &operator=(const RetireQueue &) = delete;
+  RetireQueue &operator=(RetireQueue &&) = delete;
+  // everything still queued has to be flushed before
+  ~RetireQueue() { assert(empty()); }
+
+  template <typename T>
+  void retire(T handle, uint64_t retireValue,
+              VmaAllocation allocation = nullptr) {
+    push(RetiredResource{
+        .handle = reinterpret_cast<uint64_t>(handle),
+        .allocation = allocation,
+        .retireValue = retireValue,
+        .type = resource_type<T>(),
+    });
+  }
+
+  // destroys everything retired with a value <= completedValue, returns how
+  // many objects were destroyed
+  size_t collect(uint64_t completedValue);
+
+  // destroys everything. the device has to be idle
+  void flush();
+
+  [[nodiscard]] bool empty() const { return _head == _tail; }
+  [[nodiscard]] size_t size() const { return _tail - _head; }
+  [[nodiscard]] size_t capacity() const { return _ring.size(); }
+
+ private:
+  void push(const RetiredResource &resource);
+  void grow();
+  void destroy(const RetiredResource &resource);
+
+  VkDevice _device;
+  VmaAllocator _allocator;
+
+  // power of two sized, indexed with the running head and tail counters
+  std::vector<RetiredResource> _ring;
+  size_t _head{0};
+  size_t _tail{0};
+  uint64_t _lastValue{0};
+};
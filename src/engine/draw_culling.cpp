@@ -0,0 +1,536 @@
+#include "draw_culling.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <glm/glm.hpp>
+#include <shaders/cull_comp.hpp>
+#include <shaders/depth_pyramid_comp.hpp>
+#include <stdexcept>
+
+#include "engine.hpp"
+#include "helpers.hpp"
+#include "vulkan/ini.hpp"
+#include "vulkan/util.hpp"
+
+namespace {
+
+// keep in sync with cull.comp
+enum CullFlags : uint32_t {
+  CULL_FRUSTUM = 1U << 0U,
+  CULL_OCCLUSION = 1U << 1U,
+  // no late phase follows, the early one counts what it culls
+  CULL_LAST_PHASE = 1U << 2U,
+};
+
+// layout of the push constant block in cull.comp
+struct CullPushConstants {
+  VkDeviceAddress draws;
+  VkDeviceAddress camera;
+  VkDeviceAddress commands;
+  VkDeviceAddress stats;
+  uint32_t drawCount;
+  uint32_t phase;
+  uint32_t flags;
+  uint32_t pyramidLevels;
+  glm::vec2 pyramidSize;
+};
+
+// layout of the push constant block in depth_pyramid.comp
+struct PyramidPushConstants {
+  int32_t sourceWidth;
+  int32_t sourceHeight;
+  int32_t targetWidth;
+  int32_t targetHeight;
+};
+
+// what cull.comp counts, in the order of CullingStats
+struct CullCounters {
+  uint32_t drawnEarly;
+  uint32_t drawnLate;
+  uint32_t frustumCulled;
+  uint32_t occluded;
+};
+
+// buffers start out with room for this many draws
+constexpr uint32_t MIN_CAPACITY = 1024;
+
+uint32_t group_count(uint32_t size, uint32_t groupSize) {
+  return (size + groupSize - 1) / groupSize;
+}
+
+VkDeviceAddress device_address(VkDevice device, VkBuffer buffer) {
+  const VkBufferDeviceAddressInfo info{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = buffer};
+  return vkGetBufferDeviceAddress(device, &info);
+}
+
+VkDescriptorSetLayout create_set_layout(
+    VkDevice device, std::span<const VkDescriptorType> bindings) {
+  std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+  for (uint32_t binding = 0; binding < bindings.size(); binding++) {
+    layoutBindings.push_back(VkDescriptorSetLayoutBinding{
+        .binding = binding,
+        .descriptorType = bindings[binding],
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+    });
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
+  layoutInfo.pBindings = layoutBindings.data();
+
+  VkDescriptorSetLayout layout{};
+  vk_check(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout));
+  return layout;
+}
+
+VkPipelineLayout create_pipeline_layout(VkDevice device,
+                                        VkDescriptorSetLayout setLayout,
+                                        uint32_t pushConstantSize) {
+  VkPushConstantRange pushConstant{};
+  pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstant.size = pushConstantSize;
+
+  VkPipelineLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layoutInfo.setLayoutCount = 1;
+  layoutInfo.pSetLayouts = &setLayout;
+  layoutInfo.pushConstantRangeCount = 1;
+  layoutInfo.pPushConstantRanges = &pushConstant;
+
+  VkPipelineLayout layout{};
+  vk_check(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &layout));
+  return layout;
+}
+
+VkPipeline create_pipeline(VkDevice device, std::span<const uint32_t> code,
+                           VkPipelineLayout layout, const char *name) {
+  VkShaderModule shader{};
+  if (!vkutil::load_shader_module(code, device, &shader)) {
+    throw std::runtime_error(
+        fmt::format("Error when building the {} shader module", name));
+  }
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shader;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = layout;
+
+  VkPipeline pipeline{};
+  vk_check(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo,
+                                    nullptr, &pipeline));
+
+  vkDestroyShaderModule(device, shader, nullptr);
+  return pipeline;
+}
+
+}  // namespace
+
+DrawCulling::DrawCulling(VkDevice device, VmaAllocator allocator,
+                         MemoryStats &memoryStats, uint32_t frameCount,
+                         bool occlusion)
+    : _device{device},
+      _allocator{allocator},
+      _memoryStats{memoryStats},
+      _occlusion{occlusion},
+      _slots(frameCount) {
+  const std::array cullBindings{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER};
+  const std::array pyramidBindings{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                   VK_DESCRIPTOR_TYPE_STORAGE_IMAGE};
+  _cullSetLayout = create_set_layout(_device, cullBindings);
+  _pyramidSetLayout = create_set_layout(_device, pyramidBindings);
+
+  // a cull set per phase and a set per pyramid level for every slot
+  const uint32_t setsPerSlot = CULL_PHASES + MAX_PYRAMID_LEVELS;
+  const std::array poolSizes{
+      VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                           .descriptorCount = frameCount * setsPerSlot},
+      VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                           .descriptorCount = frameCount * MAX_PYRAMID_LEVELS},
+  };
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = frameCount * setsPerSlot;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  vk_check(vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_pool));
+
+  std::array<VkDescriptorSetLayout, CULL_PHASES + MAX_PYRAMID_LEVELS>
+      layouts{};
+  layouts.fill(_pyramidSetLayout);
+  std::fill_n(layouts.begin(), CULL_PHASES, _cullSetLayout);
+  for (FrameSlot &slot : _slots) {
+    std::array<VkDescriptorSet, CULL_PHASES + MAX_PYRAMID_LEVELS> sets{};
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _pool;
+    allocInfo.descriptorSetCount = setsPerSlot;
+    allocInfo.pSetLayouts = layouts.data();
+    vk_check(vkAllocateDescriptorSets(_device, &allocInfo, sets.data()));
+
+    std::copy_n(sets.begin(), CULL_PHASES, slot.cullSets.begin());
+    std::copy(sets.begin() + CULL_PHASES, sets.end(),
+              slot.pyramidSets.begin());
+
+    grow(slot, MIN_CAPACITY);
+    slot.stats.emplace(sizeof(CullCounters),
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                       VMA_MEMORY_USAGE_GPU_TO_CPU, MemoryCategory::Other);
+    slot.statsAddress = device_address(_device, slot.stats->_buffer);
+  }
+
+  _cullLayout = create_pipeline_layout(_device, _cullSetLayout,
+                                       sizeof(CullPushConstants));
+  _pyramidLayout = create_pipeline_layout(_device, _pyramidSetLayout,
+                                          sizeof(PyramidPushConstants));
+  _cullPipeline = create_pipeline(_device, spirv::cull_comp, _cullLayout,
+                                  "culling");
+  _pyramidPipeline = create_pipeline(_device, spirv::depth_pyramid_comp,
+                                     _pyramidLayout, "depth pyramid");
+
+  // only ever read with texelFetch, which ignores filtering
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+  vk_check(vkCreateSampler(_device, &samplerInfo, nullptr, &_sampler));
+}
+
+DrawCulling::~DrawCulling() {
+  destroy_pyramid();
+  vkDestroySampler(_device, _sampler, nullptr);
+  vkDestroyPipeline(_device, _cullPipeline, nullptr);
+  vkDestroyPipeline(_device, _pyramidPipeline, nullptr);
+  vkDestroyPipelineLayout(_device, _cullLayout, nullptr);
+  vkDestroyPipelineLayout(_device, _pyramidLayout, nullptr);
+  // frees the sets too
+  vkDestroyDescriptorPool(_device, _pool, nullptr);
+  vkDestroyDescriptorSetLayout(_device, _cullSetLayout, nullptr);
+  vkDestroyDescriptorSetLayout(_device, _pyramidSetLayout, nullptr);
+}
+
+void DrawCulling::grow(FrameSlot &slot, uint32_t drawCount) {
+  // the slot's previous frame is complete, the old buffers can go right away
+  slot.capacity = std::bit_ceil(std::max(drawCount, MIN_CAPACITY));
+
+  slot.commands.emplace(
+      CULL_PHASES * slot.capacity * sizeof(VkDrawIndexedIndirectCommand),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+          VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+      VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::Other);
+
+  slot.commandsAddress = device_address(_device, slot.commands->_buffer);
+}
+
+void DrawCulling::begin_frame(uint32_t frameSlot,
+                              std::span<const RenderObject> objects,
+                              VkDeviceAddress camera,
+                              LinearAllocator &transient) {
+  FrameSlot &slot = _slots.at(frameSlot);
+  _current = &slot;
+  slot.cameraAddress = camera;
+
+  auto *counters = static_cast<CullCounters *>(slot.stats->_info.pMappedData);
+  if (slot.statsRecorded) {
+    vk_check(vmaInvalidateAllocation(_allocator, slot.stats->_allocation, 0,
+                                     VK_WHOLE_SIZE));
+    _counters[0] += counters->drawnEarly;
+    _counters[1] += counters->drawnLate;
+    _counters[2] += counters->frustumCulled;
+    _counters[3] += counters->occluded;
+    _statsFrames++;
+    slot.statsRecorded = false;
+  }
+  *counters = {};
+  vk_check(vmaFlushAllocation(_allocator, slot.stats->_allocation, 0,
+                              VK_WHOLE_SIZE));
+
+  const auto drawCount = static_cast<uint32_t>(objects.size());
+  if (drawCount > slot.capacity) {
+    grow(slot, drawCount);
+  }
+  slot.drawCount = drawCount;
+
+  // flushed with the rest of the frame's transient data
+  const TransientAllocation draws =
+      transient.allocate(drawCount * sizeof(DrawData), alignof(DrawData));
+  auto *data = static_cast<DrawData *>(draws.data);
+  for (uint32_t i = 0; i < drawCount; i++) {
+    data[i] = objects[i].draw;
+  }
+  slot.drawsAddress = draws.address;
+}
+
+void DrawCulling::resize(VkExtent2D extent) {
+  // the largest power of two that fits, so every level halves the one above
+  const VkExtent2D pyramidExtent{std::bit_floor(extent.width),
+                                 std::bit_floor(extent.height)};
+  if (_pyramid.image != VK_NULL_HANDLE &&
+      pyramidExtent.width == _pyramidExtent.width &&
+      pyramidExtent.height == _pyramidExtent.height) {
+    return;
+  }
+
+  if (_pyramid.image != VK_NULL_HANDLE) {
+    Engine &engine = Engine::instance();
+    _memoryStats.untrack(_pyramid.allocation);
+    engine.retire(_pyramid.view);
+    for (VkImageView view : _pyramid.levelViews) {
+      engine.retire(view);
+    }
+    engine.retire(_pyramid.image, _pyramid.allocation);
+    _pyramid = {};
+  }
+
+  _pyramidExtent = pyramidExtent;
+  _pyramidLevels = std::min<uint32_t>(
+      std::bit_width(std::max(pyramidExtent.width, pyramidExtent.height)),
+      MAX_PYRAMID_LEVELS);
+  _pyramidValid = false;
+
+  VkImageCreateInfo imageInfo = vkini::image_create_info(
+      VK_FORMAT_R32_SFLOAT,
+      VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+      {pyramidExtent.width, pyramidExtent.height, 1});
+  imageInfo.mipLevels = _pyramidLevels;
+
+  VmaAllocationCreateInfo allocInfo = {};
+  allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+  allocInfo.requiredFlags =
+      VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  allocInfo.pUserData = MemoryStats::user_data(MemoryCategory::RenderTarget);
+
+  vk_check(vmaCreateImage(_allocator, &imageInfo, &allocInfo, &_pyramid.image,
+                          &_pyramid.allocation, nullptr));
+  _memoryStats.track(_pyramid.allocation);
+
+  VkImageViewCreateInfo viewInfo = vkini::imageview_create_info(
+      VK_FORMAT_R32_SFLOAT, _pyramid.image, VK_IMAGE_ASPECT_COLOR_BIT);
+  viewInfo.subresourceRange.levelCount = _pyramidLevels;
+  vk_check(vkCreateImageView(_device, &viewInfo, nullptr, &_pyramid.view));
+
+  viewInfo.subresourceRange.levelCount = 1;
+  _pyramid.levelViews.resize(_pyramidLevels);
+  for (uint32_t level = 0; level < _pyramidLevels; level++) {
+    viewInfo.subresourceRange.baseMipLevel = level;
+    vk_check(vkCreateImageView(_device, &viewInfo, nullptr,
+                               &_pyramid.levelViews[level]));
+  }
+}
+
+void DrawCulling::destroy_pyramid() {
+  if (_pyramid.image == VK_NULL_HANDLE) {
+    return;
+  }
+  vkDestroyImageView(_device, _pyramid.view, nullptr);
+  for (VkImageView view : _pyramid.levelViews) {
+    vkDestroyImageView(_device, view, nullptr);
+  }
+  _memoryStats.untrack(_pyramid.allocation);
+  vmaDestroyImage(_allocator, _pyramid.image, _pyramid.allocation);
+  _pyramid = {};
+}
+
+IndirectDraws DrawCulling::indirect(CullPhase phase) const {
+  return IndirectDraws{
+      .draws = _current->drawsAddress,
+      .camera = _current->cameraAddress,
+      .commands = _current->commands->_buffer,
+      .offset = static_cast<uint32_t>(phase) * _current->drawCount *
+                sizeof(VkDrawIndexedIndirectCommand),
+  };
+}
+
+VkBuffer DrawCulling::commands() const { return _current->commands->_buffer; }
+
+void DrawCulling::record_cull(VkCommandBuffer cmd, CullPhase phase) {
+  FrameSlot &slot = *_current;
+  if (slot.drawCount == 0) {
+    return;
+  }
+
+  // the slot's previous frame is complete, so its sets are no longer in use.
+  // written every frame since resize may have replaced the pyramid
+  const VkDescriptorSet cullSet = slot.cullSets[static_cast<uint32_t>(phase)];
+  const VkDescriptorImageInfo pyramidInfo{
+      .sampler = _sampler,
+      .imageView = _pyramid.view,
+      .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  const VkWriteDescriptorSet write{
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet = cullSet,
+      .dstBinding = 0,
+      .descriptorCount = 1,
+      .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      .pImageInfo = &pyramidInfo,
+  };
+  vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+
+  // without occlusion culling there is only the early phase. the first
+  // early phase after the pyramid was created only has the frustum to go by
+  uint32_t flags{CULL_FRUSTUM};
+  if (!_occlusion) {
+    flags |= CULL_LAST_PHASE;
+  } else if (phase == CullPhase::Late || _pyramidValid) {
+    flags |= CULL_OCCLUSION;
+  }
+
+  const CullPushConstants constants{
+      .draws = slot.drawsAddress,
+      .camera = slot.cameraAddress,
+      .commands = slot.commandsAddress,
+      .stats = slot.statsAddress,
+      .drawCount = slot.drawCount,
+      .phase = static_cast<uint32_t>(phase),
+      .flags = flags,
+      .pyramidLevels = _pyramidLevels,
+      .pyramidSize = glm::vec2(float(_pyramidExtent.width),
+                               float(_pyramidExtent.height)),
+  };
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipeline);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullLayout, 0,
+                          1, &cullSet, 0, nullptr);
+  vkCmdPushConstants(cmd, _cullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(constants), &constants);
+  vkCmdDispatch(cmd, group_count(slot.drawCount, GROUP_SIZE), 1, 1);
+
+  // the counters are read back on the host once the frame's fence signaled
+  VkMemoryBarrier2 barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+  barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+  barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+  barrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+  barrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+  VkDependencyInfo dependency{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+  dependency.memoryBarrierCount = 1;
+  dependency.pMemoryBarriers = &barrier;
+  vkCmdPipelineBarrier2(cmd, &dependency);
+
+  slot.statsRecorded = true;
+}
+
+void DrawCulling::record_pyramid(VkCommandBuffer cmd, VkImageView depth,
+                                 VkExtent2D depthExtent) {
+  FrameSlot &slot = *_current;
+
+  std::array<VkDescriptorImageInfo, MAX_PYRAMID_LEVELS> sourceInfos{};
+  std::array<VkDescriptorImageInfo, MAX_PYRAMID_LEVELS> targetInfos{};
+  std::array<VkWriteDescriptorSet, 2 * MAX_PYRAMID_LEVELS> writes{};
+  for (uint32_t level = 0; level < _pyramidLevels; level++) {
+    sourceInfos[level] = VkDescriptorImageInfo{
+        .sampler = _sampler,
+        .imageView = level == 0 ? depth : _pyramid.levelViews[level - 1],
+        .imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                                  : VK_IMAGE_LAYOUT_GENERAL};
+    targetInfos[level] = VkDescriptorImageInfo{
+        .imageView = _pyramid.levelViews[level],
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+
+    writes[2 * level] = VkWriteDescriptorSet{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = slot.pyramidSets[level],
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &sourceInfos[level],
+    };
+    writes[2 * level + 1] = VkWriteDescriptorSet{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = slot.pyramidSets[level],
+        .dstBinding = 1,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        .pImageInfo = &targetInfos[level],
+    };
+  }
+  vkUpdateDescriptorSets(_device, 2 * _pyramidLevels, writes.data(), 0,
+                         nullptr);
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pyramidPipeline);
+
+  VkExtent2D sourceExtent = depthExtent;
+  VkExtent2D targetExtent = _pyramidExtent;
+  for (uint32_t level = 0; level < _pyramidLevels; level++) {
+    if (level != 0) {
+      // each level reads the one written before it
+      VkMemoryBarrier2 barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+      barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+      barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+      barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+      barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+      VkDependencyInfo dependency{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+      dependency.memoryBarrierCount = 1;
+      dependency.pMemoryBarriers = &barrier;
+      vkCmdPipelineBarrier2(cmd, &dependency);
+    }
+
+    const PyramidPushConstants constants{
+        .sourceWidth = static_cast<int32_t>(sourceExtent.width),
+        .sourceHeight = static_cast<int32_t>(sourceExtent.height),
+        .targetWidth = static_cast<int32_t>(targetExtent.width),
+        .targetHeight = static_cast<int32_t>(targetExtent.height),
+    };
+
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            _pyramidLayout, 0, 1, &slot.pyramidSets[level], 0,
+                            nullptr);
+    vkCmdPushConstants(cmd, _pyramidLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(constants), &constants);
+    vkCmdDispatch(cmd, group_count(targetExtent.width, PYRAMID_GROUP_SIZE),
+                  group_count(targetExtent.height, PYRAMID_GROUP_SIZE), 1);
+
+    sourceExtent = targetExtent;
+    targetExtent = {std::max(targetExtent.width / 2, 1U),
+                    std::max(targetExtent.height / 2, 1U)};
+  }
+
+  _pyramidValid = true;
+}
+
+CullingStats DrawCulling::stats() const {
+  if (_statsFrames == 0) {
+    return {};
+  }
+  const auto frames = double(_statsFrames);
+  return CullingStats{
+      .drawnEarly = double(_counters[0]) / frames,
+      .drawnLate = double(_counters[1]) / frames,
+      .frustumCulled = double(_counters[2]) / frames,
+      .occluded = double(_counters[3]) / frames,
+  };
+}
+
+void DrawCulling::print() const {
+  const CullingStats culling = stats();
+  const double total = culling.drawnEarly + culling.drawnLate +
+                       culling.frustumCulled + culling.occluded;
+  if (total == 0.) {
+    return;
+  }
+  fmt::print(
+      "culling: {:.0f} drawn early, {:.0f} late, {:.1f}% outside the "
+      "frustum, {:.1f}% occluded\n",
+      culling.drawnEarly, culling.drawnLate,
+      100. * culling.frustumCulled / total, 100. * culling.occluded / total);
+}
+
+void DrawCulling::reset_stats() {
+  _counters = {};
+  _statsFrames = 0;
+}
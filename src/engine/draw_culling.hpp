@@ -0,0 +1,157 @@
+#pragma once
+
+#include <vk_mem_alloc.h>
+#include <volk.h>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "linear_allocator.hpp"
+#include "memory_stats.hpp"
+#include "render_object.hpp"
+#include "struct.hpp"
+
+// with occlusion culling a frame is drawn in two phases, see DrawCulling
+enum class CullPhase : uint32_t {
+  Early,
+  Late,
+};
+
+constexpr uint32_t CULL_PHASES = 2;
+
+// objects per frame by what culling decided about them, averaged since the
+// last reset
+struct CullingStats {
+  double drawnEarly;
+  double drawnLate;
+  double frustumCulled;
+  double occluded;
+};
+
+// gpu driven culling of the draw list, see shaders/cull.comp. the objects'
+// DrawData is uploaded every frame and a compute pass writes each one's
+// indirect draw command, without instances if it is outside the frustum.
+//
+// with occlusion culling objects are also tested against a hi-z pyramid, the
+// farthest depth of every 2^n pixel block, in two phases: the early phase
+// tests against the previous frame's pyramid and its survivors are drawn.
+// the pyramid is rebuilt from that depth and the late phase retests what the
+// early one skipped, so objects coming into view show up the same frame.
+// without it everything in the frustum is drawn in the early phase
+class DrawCulling {
+ public:
+  // workgroup sizes, keep in sync with cull.comp and depth_pyramid.comp
+  static constexpr uint32_t GROUP_SIZE = 64;
+  static constexpr uint32_t PYRAMID_GROUP_SIZE = 8;
+  static constexpr uint32_t MAX_PYRAMID_LEVELS = 16;
+
+  // frameCount sets of buffers are kept, one per frame in flight
+  DrawCulling(VkDevice device, VmaAllocator allocator,
+              MemoryStats &memoryStats, uint32_t frameCount, bool occlusion);
+  DrawCulling(const DrawCulling &) = delete;
+  DrawCulling(DrawCulling &&) = delete;
+  DrawCulling &operator=(const DrawCulling &) = delete;
+  DrawCulling &operator=(DrawCulling &&) = delete;
+  // the gpu has to be done with every frame
+  ~DrawCulling();
+
+  // reads back the stats the slot recorded last time and uploads the
+  // objects' DrawData into the frame's transient allocator. camera is the
+  // frame's CameraData. the slot's previous frame has to be complete
+  void begin_frame(uint32_t frameSlot, std::span<const RenderObject> objects,
+                   VkDeviceAddress camera, LinearAllocator &transient);
+
+  // sizes the pyramid for a depth buffer of extent, recreating it if that
+  // changed. the old one is retired
+  void resize(VkExtent2D extent);
+
+  // where the phase's draws read their commands, for record_draws
+  [[nodiscard]] IndirectDraws indirect(CullPhase phase) const;
+
+  // the commands of both phases, for the render graph
+  [[nodiscard]] VkBuffer commands() const;
+
+  [[nodiscard]] bool occlusion() const { return _occlusion; }
+
+  // the pyramid is in SHADER_READ_ONLY_OPTIMAL between frames once it was
+  // built, its contents are undefined before
+  [[nodiscard]] VkImage pyramid() const { return _pyramid.image; }
+  [[nodiscard]] VkImageView pyramid_view() const { return _pyramid.view; }
+  [[nodiscard]] VkExtent2D pyramid_extent() const { return _pyramidExtent; }
+  [[nodiscard]] bool pyramid_valid() const { return _pyramidValid; }
+
+  // writes the phase's commands. the pyramid has to be in
+  // SHADER_READ_ONLY_OPTIMAL, the late phase reads the early commands
+  void record_cull(VkCommandBuffer cmd, CullPhase phase);
+
+  // builds the pyramid from the top left depthExtent of depth, which has to
+  // be in SHADER_READ_ONLY_OPTIMAL. the pyramid has to be in GENERAL
+  void record_pyramid(VkCommandBuffer cmd, VkImageView depth,
+                      VkExtent2D depthExtent);
+
+  [[nodiscard]] CullingStats stats() const;
+  void print() const;
+  // forgets the stats so far, e.g. after warming up
+  void reset_stats();
+
+ private:
+  struct FrameSlot {
+    // the gpu written commands, early then late
+    std::optional<AllocatedBuffer> commands;
+    std::optional<AllocatedBuffer> stats;
+    // this frame's DrawData, transient
+    VkDeviceAddress drawsAddress{};
+    VkDeviceAddress cameraAddress{};
+    VkDeviceAddress commandsAddress{};
+    VkDeviceAddress statsAddress{};
+    uint32_t capacity{0};
+    uint32_t drawCount{0};
+    // stats has to be read back before it is reused
+    bool statsRecorded{false};
+    // one per phase, the late phase can't update the set the early phase's
+    // command buffer has bound
+    std::array<VkDescriptorSet, CULL_PHASES> cullSets{};
+    std::array<VkDescriptorSet, MAX_PYRAMID_LEVELS> pyramidSets{};
+  };
+
+  struct Pyramid {
+    VkImage image{};
+    VmaAllocation allocation{};
+    // all levels, for culling
+    VkImageView view{};
+    // one per level, for building it
+    std::vector<VkImageView> levelViews;
+  };
+
+  void grow(FrameSlot &slot, uint32_t drawCount);
+  void destroy_pyramid();
+
+  VkDevice _device;
+  VmaAllocator _allocator;
+  MemoryStats &_memoryStats;
+  bool _occlusion;
+
+  std::vector<FrameSlot> _slots;
+  FrameSlot *_current{};
+
+  VkDescriptorSetLayout _cullSetLayout{};
+  VkDescriptorSetLayout _pyramidSetLayout{};
+  VkDescriptorPool _pool{};
+  VkPipelineLayout _cullLayout{};
+  VkPipelineLayout _pyramidLayout{};
+  VkPipeline _cullPipeline{};
+  VkPipeline _pyramidPipeline{};
+  VkSampler _sampler{};
+
+  Pyramid _pyramid;
+  VkExtent2D _pyramidExtent{};
+  uint32_t _pyramidLevels{0};
+  // built at least once since it was created
+  bool _pyramidValid{false};
+
+  std::array<uint64_t, 4> _counters{};
+  uint64_t _statsFrames{0};
+};
@@ -0,0 +1,71 @@
+#include "dynamic_resolution.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <span>
+
+namespace {
+
+// aim a bit below the budget so noise doesn't push every other frame over
+constexpr double TARGET_RATIO = .95;
+// fraction of the way to the estimated scale moved per frame. drops are
+// followed quickly to hold the frame rate through spikes, recovery is slow
+// so the scale doesn't oscillate
+constexpr double DOWN_RATE = .5;
+constexpr double UP_RATE = .05;
+
+}  // namespace
+
+void DynamicResolution::update(double gpuMs) {
+  if (gpuMs > 0.) {
+    const double target = _budgetMs * TARGET_RATIO;
+    const double estimate = _scale * std::sqrt(target / gpuMs);
+    const double rate = estimate < _scale ? DOWN_RATE : UP_RATE;
+
+    _scale = std::clamp(static_cast<float>(_scale + (estimate - _scale) * rate),
+                        MIN_SCALE, MAX_SCALE);
+  }
+
+  _history[_next] = _scale;
+  _next = (_next + 1) % HISTORY;
+  _count = std::min(_count + 1, HISTORY);
+}
+
+VkExtent2D DynamicResolution::scaled(VkExtent2D full) const {
+  auto scale = [this](uint32_t size) {
+    return std::max(
+        static_cast<uint32_t>(std::lround(static_cast<float>(size) * _scale)),
+        1U);
+  };
+  return VkExtent2D{scale(full.width), scale(full.height)};
+}
+
+ResolutionScaleStats DynamicResolution::stats() const {
+  if (_count == 0) {
+    return ResolutionScaleStats{
+        .current = _scale, .min = _scale, .avg = _scale};
+  }
+
+  const auto samples = std::span(_history).first(_count);
+  return ResolutionScaleStats{
+      .current = _scale,
+      .min = std::ranges::min(samples),
+      .avg = std::accumulate(samples.begin(), samples.end(), 0.F) /
+             static_cast<float>(_count),
+  };
+}
+
+void DynamicResolution::print() const {
+  const ResolutionScaleStats scale = stats();
+  fmt::print("  resolution scale {:.2f}, min {:.2f} avg {:.2f} for a {:.2f} ms "
+             "budget\n",
+             scale.current, scale.min, scale.avg, _budgetMs);
+}
+
+void DynamicResolution::reset() {
+  _count = 0;
+  _next = 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <volk.h>
+
+#include <array>
+#include <cstddef>
+
+struct ResolutionScaleStats {
+  float current;
+  float min;
+  float avg;
+};
+
+// picks how much of the draw image is rendered each frame so the gpu frame
+// time stays within a budget. the scale applies to both axes, gpu time is
+// assumed to grow with the pixel count, i.e. with the square of the scale
+class DynamicResolution {
+ public:
+  // number of frames the scale stats are taken over
+  static constexpr size_t HISTORY = 240;
+  static constexpr float MIN_SCALE = .5F;
+  static constexpr float MAX_SCALE = 1.F;
+
+  explicit DynamicResolution(double budgetMs) : _budgetMs{budgetMs} {}
+
+  // once per frame with the newest gpu time spent on the frame's work, 0 when
+  // there is none yet
+  void update(double gpuMs);
+
+  // the part of full to render at the current scale, at least one pixel
+  [[nodiscard]] VkExtent2D scaled(VkExtent2D full) const;
+
+  [[nodiscard]] float scale() const { return _scale; }
+  [[nodiscard]] double budget_ms() const { return _budgetMs; }
+
+  // over the last HISTORY frames
+  [[nodiscard]] ResolutionScaleStats stats() const;
+
+  void print() const;
+
+  // forgets the history but keeps the current scale, e.g. after warming up
+  void reset();
+
+ private:
+  double _budgetMs;
+  float _scale{MAX_SCALE};
+
+  // ring of the last HISTORY scales
+  std::array<float, HISTORY> _history{};
+  size_t _count{0};
+  size_t _next{0};
+};
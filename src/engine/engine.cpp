@@ -3,33 +3,37 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_vulkan.h>
 #include <VkBootstrap.h>
-#include <backends/imgui_impl_sdl3.h>
-#include <backends/imgui_impl_vulkan.h>
 #include <fmt/format.h>
 #include <stb/stb_image.h>
 #include <vulkan/vulkan_core.h>
 
+#include <algorithm>
 #include <chrono>
 #include <glm/gtx/transform.hpp>
 #include <iostream>
+#include <limits>
 #include <ranges>
 #include <thread>
 
-#include "backends/imgui_impl_sdl2.h"
+#include "cpu_profiler.hpp"
 #include "helpers.hpp"
-#include "loadMesh.hpp"
 #include "viking_room.hpp"
 #include "vk_mem_alloc.h"
 #include "vulkan/ini.hpp"
+#include "vulkan/swapchain.hpp"
 #include "vulkan/util.hpp"
 
 constexpr bool bUseValidationLayers = true;
 
+// for waits that have to finish, the wait functions return VK_TIMEOUT
+// otherwise
+constexpr uint64_t NO_TIMEOUT = std::numeric_limits<uint64_t>::max();
+
 using namespace std;
 
 static Engine *loadedEngine = nullptr;
 
-Engine::Engine() { init(); }
+Engine::Engine(EngineConfig config) : _config{config} { init(); }
 Engine::~Engine() { cleanup(); }
 
 Engine &Engine::instance() {
@@ -38,29 +42,66 @@ Engine &Engine::instance() {
 }
 
 void Engine::init() {
+  if (_config.framesInFlight == 0 ||
+      _config.framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+    throw std::runtime_error(fmt::format("frames in flight must be 1 to {}",
+                                         MAX_FRAMES_IN_FLIGHT));
+  }
+
   assert(loadedEngine == nullptr);
   loadedEngine = this;
 
-  sdl_check(SDL_Init(SDL_INIT_VIDEO) >= 0);
+  _framesInFlight = _config.framesInFlight;
+  _frames.resize(_framesInFlight);
+
+  _uberShaders = _config.uberShaders;
+  _depthPrepass = _config.depthPrepass;
+  if (_config.gpuBudgetMs > 0.) {
+    _dynamicResolution.emplace(_config.gpuBudgetMs);
+  }
+
+  // headless renders into _drawImage only, there is nothing to show it in
+  if (!_config.headless) {
+    sdl_check(SDL_Init(SDL_INIT_VIDEO) >= 0);
+
+    auto window_flags =
+        SDL_WindowFlags(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
 
-  auto window_flags = SDL_WindowFlags(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+    _window = SDL_CreateWindow(
+        "Vulkan Engine", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+        int(_windowExtent.width), int(_windowExtent.height), window_flags);
+    sdl_check(_window != nullptr);
+  }
 
-  _window = SDL_CreateWindow("Vulkan Engine", SDL_WINDOWPOS_UNDEFINED,
-                             SDL_WINDOWPOS_UNDEFINED, int(_windowExtent.width),
-                             int(_windowExtent.height), window_flags);
-  sdl_check(_window != nullptr);
+  // decode the texture on a worker while vulkan and the pipelines come up
+  JobCounter textureDecoded;
+  ImagePixels texturePixels{};
+  const std::string texturePath = asset_path(VIKING_TEXTURE);
+  _jobs.run(textureDecoded, [&texturePixels, &texturePath]() {
+    PROFILE_SCOPE("decode texture");
+    texturePixels.data =
+        stbi_load(texturePath.c_str(), &texturePixels.width,
+                  &texturePixels.height, nullptr, STBI_rgb_alpha);
+  });
+  // the job writes into the locals above, so it has to be done before they
+  // go away, also when one of the init steps below throws
+  struct WaitForDecode {
+    JobSystem &jobs;
+    JobCounter &counter;
+    ~WaitForDecode() { jobs.wait(counter); }
+  } waitForDecode{_jobs, textureDecoded};
 
   init_vulkan();
   init_swapchain();
   init_commands();
   init_sync_structures();
-  init_descriptor_set_layouts();
+  init_bindless();
   init_pipelines();
-  init_texture_image();
+
+  _jobs.wait(textureDecoded);
+  init_texture_image(texturePixels);
   init_texture_sampler();
   init_default_data();
-  init_descriptor_pools();
-  init_descriptor_sets();
 
   _isInitialized = true;
 }
@@ -73,22 +114,38 @@ void Engine::cleanup() {
 
   _mainDeletionQueue.flush();
 
-  destroy_swapchain();
-
-  vkDestroySurfaceKHR(_instance, _surface, nullptr);
+  if (!_config.headless) {
+    _swapchain = std::nullopt;
+    vkDestroySurfaceKHR(_instance, _surface, nullptr);
+  }
   vkDestroyDevice(_device, nullptr);
 
   vkb::destroy_debug_utils_messenger(_instance, _debug_messenger);
   vkDestroyInstance(_instance, nullptr);
-  SDL_DestroyWindow(_window);
+  if (!_config.headless) {
+    SDL_DestroyWindow(_window);
+  }
+
+  loadedEngine = nullptr;
 }
 
 void Engine::run() {
   SDL_Event event;
   bool bQuit = false;
 
+  if (_config.headless) {
+    run_headless();
+    return;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point fpsStart = Clock::now();
+  int fpsStartFrame = _frameNumber;
+
   // main loop
   while (!bQuit) {
+    PROFILE_SCOPE("frame");
+
     // Handle events on queue
     while (SDL_PollEvent(&event) != 0) {
       // close the window when user alt-f4s or clicks the X button
@@ -108,6 +165,13 @@ void Engine::run() {
         }
       }
 
+      if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F12) {
+        write_trace();
+      }
+      if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F11) {
+        write_memory_report();
+      }
+
       // mainCamera.processSDLEvent(e);
       // ImGui_ImplSDL2_ProcessEvent(&e);
     }
@@ -116,34 +180,115 @@ void Engine::run() {
       continue;
     }
 
-    // if (_resize_requested) {
-    //   resize_swapchain();
-    // }
+    if (_resize_requested) {
+      resize_swapchain();
+    }
 
     draw();
+
+    if (_config.traceFrames != 0 &&
+        static_cast<uint32_t>(_frameNumber) == _config.traceFrames) {
+      write_trace();
+    }
+
+    if (_config.uncapped) {
+      Clock::time_point now = Clock::now();
+      std::chrono::duration<double> elapsed = now - fpsStart;
+      if (elapsed.count() >= 1.) {
+        int frames = _frameNumber - fpsStartFrame;
+        fmt::print("{:.1f} fps, {:.3f} ms/frame\n", frames / elapsed.count(),
+                   1000. * elapsed.count() / frames);
+        _gpuProfiler->print();
+        _drawCulling->print();
+        if (_dynamicResolution) {
+          _dynamicResolution->print();
+        }
+        fpsStart = now;
+        fpsStartFrame = _frameNumber;
+      }
+    }
+  }
+}
+
+void Engine::run_headless() {
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start = Clock::now();
+
+  for (uint32_t i = 0; i < _config.headlessFrames; i++) {
+    PROFILE_SCOPE("frame");
+    draw();
+  }
+  vk_check(vkDeviceWaitIdle(_device));
+
+  if (!_config.tracePath.empty()) {
+    write_trace();
+  }
+  _memoryStats->print();
+  if (!_config.memoryReportPath.empty()) {
+    write_memory_report();
+  }
+
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  fmt::print("rendered {} frames in {:.3f} s, {:.3f} ms/frame\n",
+             _config.headlessFrames, elapsed.count(),
+             1000. * elapsed.count() / _config.headlessFrames);
+  _gpuProfiler->print();
+  _drawCulling->print();
+  if (_dynamicResolution) {
+    _dynamicResolution->print();
   }
 }
 
+void Engine::write_trace() {
+  if (_config.tracePath.empty()) {
+    fmt::print("no trace file given, start with --trace <file>\n");
+    return;
+  }
+#ifdef ENGINE_CPU_PROFILER
+  profiler::write_chrome_trace(_config.tracePath);
+  profiler::clear();
+#else
+  fmt::print("built without ENGINE_CPU_PROFILER, nothing to write\n");
+#endif
+}
+
+void Engine::write_memory_report() {
+  if (_config.memoryReportPath.empty()) {
+    fmt::print("no memory report file given, start with --memory-report\n");
+    return;
+  }
+  _memoryStats->write_json(_config.memoryReportPath);
+}
+
+std::string Engine::asset_path(std::string_view relative) const {
+  std::string path = _config.assetDir;
+  path += '/';
+  path += relative;
+  return path;
+}
+
 GPUMeshBuffers Engine::upload_mesh(std::span<const Vertex> vertices,
                                    std::span<const uint32_t> indices) {
+  PROFILE_SCOPE("upload_mesh");
+
   const size_t vertexBufferSize = vertices.size() * sizeof(vertices[0]);
   VkBufferUsageFlags vbUsages{};
   vbUsages |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
   vbUsages |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
   vbUsages |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
   AllocatedBuffer vertexBuffer(vertexBufferSize, vbUsages,
-                               VMA_MEMORY_USAGE_GPU_ONLY);
+                               VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::Mesh);
 
   const size_t indexBufferSize = indices.size() * sizeof(indices[0]);
   VkBufferUsageFlags ibUsages{};
   ibUsages |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
   ibUsages |= VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
   AllocatedBuffer indexBuffer(indexBufferSize, ibUsages,
-                              VMA_MEMORY_USAGE_GPU_ONLY);
+                              VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::Mesh);
 
   AllocatedBuffer staging{vertexBufferSize + indexBufferSize,
                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                          VMA_MEMORY_USAGE_CPU_ONLY};
+                          VMA_MEMORY_USAGE_CPU_ONLY, MemoryCategory::Staging};
 
   vmaCopyMemoryToAllocation(_allocator, vertices.data(), staging._allocation, 0,
                             vertexBufferSize);
@@ -175,16 +320,43 @@ GPUMeshBuffers Engine::upload_mesh(std::span<const Vertex> vertices,
 }
 
 FrameData &Engine::get_current_frame() {
-  return _frames.at(_frameNumber % FRAME_OVERLAP);
+  return _frames.at(frame_slot());
+}
+
+uint64_t Engine::completed_frame_value() {
+  uint64_t value{0};
+  vk_check(vkGetSemaphoreCounterValue(_device, _frameTimeline, &value));
+  _completedFrameValue = std::max(_completedFrameValue, value);
+  return _completedFrameValue;
+}
+
+void Engine::wait_for_frame(uint64_t value) {
+  if (value <= _completedFrameValue) {
+    return;
+  }
+
+  VkSemaphoreWaitInfo waitInfo{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+                               .semaphoreCount = 1,
+                               .pSemaphores = &_frameTimeline,
+                               .pValues = &value};
+  // no timeout, vk_check would treat VK_TIMEOUT as fatal. a slow frame, e.g.
+  // 100k draws on a software rasterizer, is not an error
+  vk_check(vkWaitSemaphores(_device, &waitInfo, NO_TIMEOUT));
+  _completedFrameValue = value;
 }
 
 void Engine::init_vulkan() {
+  // finds the loader, every other function is loaded once there is an
+  // instance or device to load it from
+  vk_check(volkInitialize());
+
   // make the vulkan instance, with basic debug features
-  auto inst_ret = vkb::InstanceBuilder()
+  auto inst_ret = vkb::InstanceBuilder(vkGetInstanceProcAddr)
                       .set_app_name("Example Vulkan Application")
                       .request_validation_layers(bUseValidationLayers)
                       .use_default_debug_messenger()
                       .require_api_version(1, 3, 0)
+                      .set_headless(_config.headless)
                       .build();
 
   vkb::Instance vkb_inst = inst_ret.value();
@@ -192,10 +364,19 @@ void Engine::init_vulkan() {
   // grab the instance
   _instance = vkb_inst.instance;
   _debug_messenger = vkb_inst.debug_messenger;
+  if (_config.loaderDispatch) {
+    // device functions too, as the loader's trampolines that look up the
+    // device's dispatch table on every call
+    volkLoadInstance(_instance);
+  } else {
+    volkLoadInstanceOnly(_instance);
+  }
 
-  sdl_check(SDL_Vulkan_CreateSurface(_window, _instance, &_surface) ==
-            SDL_TRUE);
-  assert(_surface != nullptr);
+  if (!_config.headless) {
+    sdl_check(SDL_Vulkan_CreateSurface(_window, _instance, &_surface) ==
+              SDL_TRUE);
+    assert(_surface != nullptr);
+  }
 
   VkPhysicalDeviceVulkan13Features features13{
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
@@ -205,100 +386,264 @@ void Engine::init_vulkan() {
   VkPhysicalDeviceVulkan12Features features12{
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
   features12.bufferDeviceAddress = true;
+  features12.timelineSemaphore = true;
+  // the gpu profiler resets its queries from the cpu, they may be written on
+  // more than one queue
+  features12.hostQueryReset = true;
   features12.descriptorIndexing = true;
+  // for the bindless table
+  features12.runtimeDescriptorArray = true;
+  features12.descriptorBindingPartiallyBound = true;
+  features12.descriptorBindingSampledImageUpdateAfterBind = true;
+  features12.descriptorBindingUpdateUnusedWhilePending = true;
+  // draws of one multi draw indirect pick their texture per instance, see
+  // nonuniformEXT in colored_triangle.frag
+  features12.shaderSampledImageArrayNonUniformIndexing = true;
 
   VkPhysicalDeviceFeatures features{};
   features.samplerAnisotropy = true;
+  // every object is a command of one multi draw indirect, which passes its
+  // index to the shaders as firstInstance
+  features.multiDrawIndirect = true;
+  features.drawIndirectFirstInstance = true;
 
   vkb::PhysicalDeviceSelector selector{vkb_inst};
-  vkb::PhysicalDevice physicalDevice = selector.set_minimum_version(1, 3)
-                                           .set_required_features_13(features13)
-                                           .set_required_features_12(features12)
-                                           .set_required_features(features)
-                                           .set_surface(_surface)
-                                           .select()
-                                           .value();
+  selector.set_minimum_version(1, 3)
+      .set_required_features_13(features13)
+      .set_required_features_12(features12)
+      .set_required_features(features);
+
+  if (_config.headless) {
+    // no surface to present to. this also lets software drivers like
+    // lavapipe be picked on machines without a gpu
+    selector.require_present(false);
+  } else {
+    selector.set_surface(_surface);
+  }
+
+  vkb::PhysicalDevice physicalDevice = selector.select().value();
+
+  // lets the composite write the swapchain without knowing its format
+  VkPhysicalDeviceFeatures writeWithoutFormat{};
+  writeWithoutFormat.shaderStorageImageWriteWithoutFormat = true;
+  bool computeComposite =
+      !_config.blitPresent &&
+      physicalDevice.enable_features_if_present(writeWithoutFormat);
+  if (computeComposite && !_config.headless &&
+      !Swapchain::supports_storage(physicalDevice.physical_device, _surface)) {
+    computeComposite = false;
+  }
+  if (!_config.blitPresent && !computeComposite) {
+    fmt::print("swapchain can't be written from compute, blitting instead\n");
+  }
+
+  // counts fragment shader invocations for the gpu profiler. the query stays
+  // active while the geometry secondaries execute, so they inherit it
+  VkPhysicalDeviceFeatures statisticsQuery{};
+  statisticsQuery.pipelineStatisticsQuery = true;
+  statisticsQuery.inheritedQueries = true;
+  const bool pipelineStatistics =
+      physicalDevice.enable_features_if_present(statisticsQuery);
+
+  // lets vma report real per process usage and budgets instead of guessing
+  const bool memoryBudget = physicalDevice.enable_extension_if_present(
+      VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+  if (_config.descriptorBuffer) {
+    VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures{
+        .sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT};
+    descriptorBufferFeatures.descriptorBuffer = true;
+
+    if (physicalDevice.enable_extension_if_present(
+            VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME) &&
+        physicalDevice.enable_extension_features_if_present(
+            descriptorBufferFeatures)) {
+      _descriptorBackend = DescriptorBackend::Buffer;
+    } else {
+      fmt::print("VK_EXT_descriptor_buffer not supported, using a {}\n",
+                 to_string(DescriptorBackend::Pool));
+    }
+  }
 
   vkb::DeviceBuilder deviceBuilder{physicalDevice};
   vkb::Device vkbDevice = deviceBuilder.build().value();
 
   _device = vkbDevice.device;
   _gpu = physicalDevice.physical_device;
+  // straight from the driver, there is only ever one device
+  if (!_config.loaderDispatch) {
+    volkLoadDevice(_device);
+  }
   _graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
   _graphicsQueueFamily =
       vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+  // a family without graphics, so the queue's work can overlap the graphics
+  // queue's. the gpu profiler times passes on it too
+  if (_config.asyncCompute) {
+    auto computeFamily = vkbDevice.get_queue_index(vkb::QueueType::compute);
+    if (computeFamily.has_value() &&
+        physicalDevice.get_queue_families()[computeFamily.value()]
+                .timestampValidBits != 0) {
+      _computeQueue = vkbDevice.get_queue(vkb::QueueType::compute).value();
+      _computeQueueFamily = computeFamily.value();
+    } else {
+      fmt::print("no separate compute queue family, compute stays on the "
+                 "graphics queue\n");
+    }
+  }
+  std::vector<uint32_t> queueFamilies{_graphicsQueueFamily};
+  std::optional<RenderQueue> computeQueue;
+  if (_computeQueue != VK_NULL_HANDLE) {
+    queueFamilies.push_back(_computeQueueFamily);
+    computeQueue = RenderQueue{_computeQueue, _computeQueueFamily};
+  }
+
+  // vma loads the rest of its functions through these
+  VmaVulkanFunctions vulkanFunctions = {};
+  vulkanFunctions.vkGetInstanceProcAddr = vkGetInstanceProcAddr;
+  vulkanFunctions.vkGetDeviceProcAddr = vkGetDeviceProcAddr;
+
   VmaAllocatorCreateInfo allocatorInfo = {};
+  allocatorInfo.pVulkanFunctions = &vulkanFunctions;
   allocatorInfo.physicalDevice = _gpu;
   allocatorInfo.device = _device;
   allocatorInfo.instance = _instance;
   allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+  if (memoryBudget) {
+    allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+  }
   vmaCreateAllocator(&allocatorInfo, &_allocator);
 
   _mainDeletionQueue.push_function([&]() { vmaDestroyAllocator(_allocator); });
+
+  _retireQueue.emplace(_device, _allocator);
+  _mainDeletionQueue.push_function([this]() {
+    _retireQueue->flush();
+    _retireQueue = std::nullopt;
+  });
+
+  _memoryStats.emplace(_allocator);
+  _memoryStats->add_budget_listener([](const BudgetEvent &event) {
+    fmt::print("gpu heap {} budget {} -> {}: {} of {} bytes\n",
+               event.heap.heap, to_string(event.previous),
+               to_string(event.state), event.heap.usage, event.heap.budget);
+  });
+  _mainDeletionQueue.push_function([this]() { _memoryStats = std::nullopt; });
+
+  _gpuProfiler.emplace(_device, _gpu, queueFamilies, _framesInFlight,
+                       pipelineStatistics);
+  _mainDeletionQueue.push_function([this]() { _gpuProfiler = std::nullopt; });
+
+  if (computeComposite) {
+    _composite.emplace(_device, _framesInFlight);
+    _mainDeletionQueue.push_function([this]() { _composite = std::nullopt; });
+  }
+
+  _renderGraph.emplace(_device, _allocator, *_memoryStats, _framesInFlight,
+                       RenderQueue{_graphicsQueue, _graphicsQueueFamily},
+                       computeQueue);
+  _mainDeletionQueue.push_function([this]() { _renderGraph = std::nullopt; });
+
+  _drawCulling.emplace(_device, _allocator, *_memoryStats, _framesInFlight,
+                       _config.occlusionCulling);
+  _mainDeletionQueue.push_function([this]() { _drawCulling = std::nullopt; });
+
+  // aligned for use as any kind of dynamic buffer offset, and shared by the
+  // queues since culling reads the per draw data too
+  const VkPhysicalDeviceLimits &limits = physicalDevice.properties.limits;
+  const VkDeviceSize transientAlignment =
+      std::max(limits.minUniformBufferOffsetAlignment,
+               limits.minStorageBufferOffsetAlignment);
+  for (FrameData &frame : _frames) {
+    frame._transient.emplace(
+        _device, _allocator,
+        static_cast<VkDeviceSize>(_config.transientMb) << 20U,
+        transientAlignment, queueFamilies);
+  }
+  _mainDeletionQueue.push_function([this]() {
+    for (FrameData &frame : _frames) {
+      frame._transient = std::nullopt;
+    }
+  });
 }
 
 void Engine::init_swapchain() {
-  create_swapchain(_windowExtent.width, _windowExtent.height);
+  if (_config.headless) {
+    create_headless_target();
+  } else {
+    create_swapchain();
+  }
 
-  VkExtent3D drawImageExtent = {_windowExtent.width, _windowExtent.height, 1};
+  create_draw_image(_windowExtent);
 
-  _drawImage.format = VK_FORMAT_R16G16B16A16_SFLOAT;
-  _drawImage.extent = drawImageExtent;
+  _mainDeletionQueue.push_function([this]() { _drawImage.destroy(); });
+}
 
+void Engine::create_draw_image(VkExtent2D extent) {
   VkImageUsageFlags drawImageUsages{};
   drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
   drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
   drawImageUsages |= VK_IMAGE_USAGE_STORAGE_BIT;
   drawImageUsages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-  VkImageCreateInfo rimg_info = vkini::image_create_info(
-      _drawImage.format, drawImageUsages, drawImageExtent);
-
-  // for the draw image, we want to allocate it from gpu local memory
-  VmaAllocationCreateInfo rimg_allocinfo = {};
-  rimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-  rimg_allocinfo.requiredFlags =
-      VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-  // allocate and create the image
-  vmaCreateImage(_allocator, &rimg_info, &rimg_allocinfo, &_drawImage.image,
-                 &_drawImage.allocation, nullptr);
-
-  // build a image-view for the draw image to use for rendering
-  VkImageViewCreateInfo rview_info = vkini::imageview_create_info(
-      _drawImage.format, _drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
+  _drawImage = AllocatedImage::create(
+      VK_FORMAT_R16G16B16A16_SFLOAT, {extent.width, extent.height, 1},
+      drawImageUsages, VK_IMAGE_ASPECT_COLOR_BIT, MemoryCategory::RenderTarget);
+}
 
-  vk_check(vkCreateImageView(_device, &rview_info, nullptr, &_drawImage.view));
+void Engine::create_headless_target() {
+  _headlessTarget = AllocatedImage::create(
+      VK_FORMAT_R8G8B8A8_UNORM, {_windowExtent.width, _windowExtent.height, 1},
+      VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+      VK_IMAGE_ASPECT_COLOR_BIT, MemoryCategory::RenderTarget);
 
-  _mainDeletionQueue.push_function([this]() {
-    vkDestroyImageView(_device, _drawImage.view, nullptr);
-    vmaDestroyImage(_allocator, _drawImage.image, _drawImage.allocation);
-  });
+  _mainDeletionQueue.push_function([this]() { _headlessTarget.destroy(); });
 }
 
 void Engine::init_commands() {
-  // create a command pool for commands submitted to the graphics queue.
-  // we also want the pool to allow for resetting of individual command buffers
-  VkCommandPoolCreateInfo commandPoolInfo = vkini::command_pool_create_info(
-      _graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
-
-  for (FrameData &frame : _frames) {
-    vk_check(vkCreateCommandPool(_device, &commandPoolInfo, nullptr,
-                                 &frame._commandPool));
-
-    _mainDeletionQueue.push_function([=, this]() {
-      vkDestroyCommandPool(_device, frame._commandPool, nullptr);
-    });
+  // the frame's primary command buffers belong to the render graph
+  _recordWorkers = _jobs.worker_count();
 
-    // allocate the default command buffer that we will use for rendering
-    VkCommandBufferAllocateInfo cmdAllocInfo =
-        vkini::command_buffer_allocate_info(frame._commandPool, 1);
+  // every slice of the draw list gets its own pool per frame, so recording
+  // jobs never have to synchronize. the pools are reset as a whole
+  VkCommandPoolCreateInfo workerPoolInfo = vkini::command_pool_create_info(
+      _graphicsQueueFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
 
-    vk_check(vkAllocateCommandBuffers(_device, &cmdAllocInfo,
-                                      &frame._mainCommandBuffer));
+  for (FrameData &frame : _frames) {
+    frame._workerCommands.resize(_recordWorkers);
+
+    for (WorkerCommands &worker : frame._workerCommands) {
+      vk_check(vkCreateCommandPool(_device, &workerPoolInfo, nullptr,
+                                   &worker._commandPool));
+
+      _mainDeletionQueue.push_function([=, this]() {
+        vkDestroyCommandPool(_device, worker._commandPool, nullptr);
+      });
+
+      VkCommandBufferAllocateInfo cmdAllocInfo =
+          vkini::command_buffer_allocate_info(
+              worker._commandPool, CULL_PHASES,
+              VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+      vk_check(vkAllocateCommandBuffers(
+          _device, &cmdAllocInfo, worker._geometryCommandBuffers.data()));
+      vk_check(vkAllocateCommandBuffers(
+          _device, &cmdAllocInfo, worker._prepassCommandBuffers.data()));
+
+      for (size_t phase = 0; phase < CULL_PHASES; phase++) {
+        frame._geometrySecondaries[phase].push_back(
+            worker._geometryCommandBuffers[phase]);
+        frame._prepassSecondaries[phase].push_back(
+            worker._prepassCommandBuffers[phase]);
+      }
+    }
   }
 
+  // for immediate submits, reset one command buffer at a time
+  VkCommandPoolCreateInfo commandPoolInfo = vkini::command_pool_create_info(
+      _graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
   vk_check(vkCreateCommandPool(_device, &commandPoolInfo, nullptr,
                                &_immCommandPool));
 
@@ -322,42 +667,36 @@ void Engine::init_sync_structures() {
   _mainDeletionQueue.push_function(
       [this]() { vkDestroyFence(_device, _immFence, nullptr); });
 
-  for (FrameData &frame : _frames) {
-    vk_check(
-        vkCreateFence(_device, &fenceCreateInfo, nullptr, &frame._renderFence));
+  // frames are paced by one timeline semaphore, waiting for a value waits
+  // for that frame and every one before it
+  VkSemaphoreTypeCreateInfo timelineInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+      .initialValue = 0};
+  VkSemaphoreCreateInfo timelineCreateInfo = vkini::semaphore_create_info();
+  timelineCreateInfo.pNext = &timelineInfo;
+  vk_check(vkCreateSemaphore(_device, &timelineCreateInfo, nullptr,
+                             &_frameTimeline));
 
+  _mainDeletionQueue.push_function(
+      [this]() { vkDestroySemaphore(_device, _frameTimeline, nullptr); });
+
+  for (FrameData &frame : _frames) {
     vk_check(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr,
                                &frame._swapchainSemaphore));
     vk_check(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr,
                                &frame._renderSemaphore));
 
     _mainDeletionQueue.push_function([=, this]() {
-      vkDestroyFence(_device, frame._renderFence, nullptr);
       vkDestroySemaphore(_device, frame._swapchainSemaphore, nullptr);
       vkDestroySemaphore(_device, frame._renderSemaphore, nullptr);
     });
   }
 }
 
-void Engine::init_descriptor_set_layouts() {
-  VkDescriptorSetLayoutBinding uboLayoutBinding{};
-  uboLayoutBinding.binding = 0;
-  uboLayoutBinding.descriptorCount = 1;
-  uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  uboLayoutBinding.pImmutableSamplers = nullptr;
-  uboLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-  VkDescriptorSetLayoutCreateInfo layoutInfo{};
-  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layoutInfo.bindingCount = 1;
-  layoutInfo.pBindings = &uboLayoutBinding;
-
-  vk_check(vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr,
-                                       &_descriptorSetLayout));
-
-  _mainDeletionQueue.push_function([this]() {
-    vkDestroyDescriptorSetLayout(_device, _descriptorSetLayout, nullptr);
-  });
+void Engine::init_bindless() {
+  _bindless.emplace(_device, _gpu, _allocator, _descriptorBackend);
+  _mainDeletionQueue.push_function([this]() { _bindless = std::nullopt; });
 }
 
 void Engine::init_pipelines() {
@@ -367,54 +706,35 @@ void Engine::init_pipelines() {
   _vikingRoom.emplace();
   _vikingRoom->build_pipeline();
 
-  // _monkeyHead.emplace();
-  // _monkeyHead->build_pipeline();
-
   _mainDeletionQueue.push_function([&]() {
     _triangle = std::nullopt;
     _vikingRoom = std::nullopt;
-    _monkeyHead = std::nullopt;
   });
 }
 
-void Engine::init_texture_image() {
-  int texWidth{};
-  int texHeight{};
-  int texChannels{};
+void Engine::init_texture_image(ImagePixels pixels) {
+  const int texWidth = pixels.width;
+  const int texHeight = pixels.height;
 
-  stbi_uc *pixels = stbi_load(VIKING_TEXTURE.data(), &texWidth, &texHeight,
-                              &texChannels, STBI_rgb_alpha);
-
-  if (pixels == nullptr) {
+  if (pixels.data == nullptr) {
     throw std::runtime_error("failed to load texture image!");
   }
 
   size_t imageSize = static_cast<size_t>(texWidth) * texHeight * 4;
 
-  _textureImage.format = VK_FORMAT_R8G8B8A8_SRGB;
-  _textureImage.extent = VkExtent3D{static_cast<uint32_t>(texWidth),
-                                    static_cast<uint32_t>(texHeight), 1};
-
   AllocatedBuffer staging{imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                          VMA_MEMORY_USAGE_CPU_ONLY};
+                          VMA_MEMORY_USAGE_CPU_ONLY, MemoryCategory::Staging};
 
-  vmaCopyMemoryToAllocation(_allocator, pixels, staging._allocation, 0,
+  vmaCopyMemoryToAllocation(_allocator, pixels.data, staging._allocation, 0,
                             static_cast<size_t>(imageSize));
 
-  stbi_image_free(pixels);
+  stbi_image_free(pixels.data);
 
-  VkImageCreateInfo img_create_info = vkini::image_create_info(
-      _textureImage.format,
+  _textureImage = AllocatedImage::create(
+      VK_FORMAT_R8G8B8A8_SRGB,
+      {static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1},
       VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-      _textureImage.extent);
-
-  VmaAllocationCreateInfo img_alloc_info = {};
-  img_alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-  img_alloc_info.requiredFlags =
-      VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-  vmaCreateImage(_allocator, &img_create_info, &img_alloc_info,
-                 &_textureImage.image, &_textureImage.allocation, nullptr);
+      VK_IMAGE_ASPECT_COLOR_BIT, MemoryCategory::Texture);
 
   immediate_submit([&](VkCommandBuffer cmd) {
     vkutil::transition_image(cmd, _textureImage.image,
@@ -429,16 +749,9 @@ void Engine::init_texture_image() {
                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
   });
 
-  VkImageViewCreateInfo view_info = vkini::imageview_create_info(
-      _textureImage.format, _textureImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
-
-  vk_check(
-      vkCreateImageView(_device, &view_info, nullptr, &_textureImage.view));
+  _textureIndex = _bindless->add_texture(_textureImage.view);
 
-  _mainDeletionQueue.push_function([this]() {
-    vkDestroyImageView(_device, _textureImage.view, nullptr);
-    vmaDestroyImage(_allocator, _textureImage.image, _textureImage.allocation);
-  });
+  _mainDeletionQueue.push_function([this]() { _textureImage.destroy(); });
 }
 
 void Engine::init_texture_sampler() {
@@ -464,6 +777,7 @@ void Engine::init_texture_sampler() {
   samplerInfo.mipLodBias = 0.;
 
   vk_check(vkCreateSampler(_device, &samplerInfo, nullptr, &_textureSampler));
+  _samplerIndex = _bindless->add_sampler(_textureSampler);
 
   _mainDeletionQueue.push_function(
       [this]() { vkDestroySampler(_device, _textureSampler, nullptr); });
@@ -472,173 +786,295 @@ void Engine::init_texture_sampler() {
 void Engine::init_default_data() {
   // _triangle->init_data();
   _vikingRoom->init_data();
-  // _monkeyHead->init_data();
-}
-
-void Engine::init_descriptor_pools() {
-  std::array poolSizes{VkDescriptorPoolSize{
-      .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-      .descriptorCount = static_cast<uint32_t>(FRAME_OVERLAP)}};
-
-  VkDescriptorPoolCreateInfo poolInfo{};
-  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-  poolInfo.pPoolSizes = poolSizes.data();
-  poolInfo.maxSets = static_cast<uint32_t>(FRAME_OVERLAP);
-
-  vk_check(
-      vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool));
-
-  _mainDeletionQueue.push_function(
-      [this]() { vkDestroyDescriptorPool(_device, _descriptorPool, nullptr); });
 }
 
-void Engine::init_descriptor_sets() {
-  std::vector<VkDescriptorSetLayout> layouts(FRAME_OVERLAP,
-                                             _descriptorSetLayout);
-  VkDescriptorSetAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocInfo.descriptorPool = _descriptorPool;
-  allocInfo.descriptorSetCount = static_cast<uint32_t>(FRAME_OVERLAP);
-  allocInfo.pSetLayouts = layouts.data();
-
-  _descriptorSets.resize(FRAME_OVERLAP);
-  vk_check(
-      vkAllocateDescriptorSets(_device, &allocInfo, _descriptorSets.data()));
-
-  for (int i = 0; i < FRAME_OVERLAP; i++) {
-    VkDescriptorSet set = _frames.at(i)._descriptorSet = _descriptorSets.at(i);
-    VkDescriptorImageInfo imageInfo{};
-    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageInfo.imageView = _textureImage.view;
-    imageInfo.sampler = _textureSampler;
-
-    std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
-
-    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[0].dstSet = set;
-    descriptorWrites[0].dstBinding = 0;
-    descriptorWrites[0].dstArrayElement = 0;
-    descriptorWrites[0].descriptorType =
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptorWrites[0].descriptorCount = 1;
-    descriptorWrites[0].pImageInfo = &imageInfo;
-
-    vkUpdateDescriptorSets(_device,
-                           static_cast<uint32_t>(descriptorWrites.size()),
-                           descriptorWrites.data(), 0, nullptr);
+void Engine::create_swapchain() {
+  VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE;
+  if (_swapchain) {
+    // frames in flight may still use the old images. they are destroyed
+    // once the frame recorded next, the first one using the new swapchain,
+    // is done
+    oldSwapchain = _swapchain->handle();
+    _swapchain->retire(*_retireQueue, frame_value());
   }
-}
-
-void Engine::create_swapchain(uint32_t width, uint32_t height) {
-  vkb::SwapchainBuilder swapchainBuilder{_gpu, _device, _surface};
 
-  _swapchainImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
-
-  vkb::Swapchain vkbSwapchain =
-      swapchainBuilder
-          //.use_default_format_selection()
-          .set_desired_format(VkSurfaceFormatKHR{
-              .format = _swapchainImageFormat,
-              .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR})
-          // use vsync present mode
-          .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
-          .set_desired_extent(width, height)
-          .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
-          .build()
-          .value();
-
-  _swapchainExtent = vkbSwapchain.extent;
-  // store swapchain and its related images
-  _swapchain = vkbSwapchain.swapchain;
-  _swapchainImages = vkbSwapchain.get_images().value();
-  _swapchainImageViews = vkbSwapchain.get_image_views().value();
+  const VkImageUsageFlags usage = _composite
+                                      ? VK_IMAGE_USAGE_STORAGE_BIT
+                                      : VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  _swapchain.emplace(_gpu, _device, _surface, _windowExtent,
+                     _config.presentMode, _config.swapchainImageCount, usage,
+                     oldSwapchain);
+
+  if (oldSwapchain == VK_NULL_HANDLE &&
+      _swapchain->present_mode() != _config.presentMode) {
+    fmt::print("present mode {} not supported, using {}\n",
+               vk::to_string(vk::PresentModeKHR(_config.presentMode)),
+               vk::to_string(vk::PresentModeKHR(_swapchain->present_mode())));
+  }
 }
 
-void Engine::destroy_swapchain() {
-  vkDestroySwapchainKHR(_device, _swapchain, nullptr);
+void Engine::resize_swapchain() {
+  PROFILE_SCOPE("resize_swapchain");
 
-  for (const VkImageView &imageview : _swapchainImageViews) {
-    vkDestroyImageView(_device, imageview, nullptr);
+  int width{};
+  int height{};
+  SDL_Vulkan_GetDrawableSize(_window, &width, &height);
+  if (width == 0 || height == 0) {
+    // nothing to present to, keep the request until the window has a size
+    return;
+  }
+  _resize_requested = false;
+
+  _windowExtent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+  create_swapchain();
+
+  // the draw image only grows. smaller windows render into a corner of it,
+  // so shrinking and growing back never reallocates
+  const VkExtent2D extent = _swapchain->extent();
+  if (extent.width > _drawImage.extent.width ||
+      extent.height > _drawImage.extent.height) {
+    _memoryStats->untrack(_drawImage.allocation);
+    retire(_drawImage.view);
+    retire(_drawImage.image, _drawImage.allocation);
+
+    create_draw_image({std::max(extent.width, _drawImage.extent.width),
+                       std::max(extent.height, _drawImage.extent.height)});
   }
 }
 
 void Engine::draw() {
-  // wait until the gpu has finished rendering the last frame. Timeout of 1
-  // second
-  FrameData &frame = get_current_frame();
-  vk_check(vkWaitForFences(_device, 1, &frame._renderFence, true, 1000000000));
-  vk_check(vkResetFences(_device, 1, &frame._renderFence));
+  PROFILE_SCOPE("draw");
 
-  frame._deletionQueue.flush();
+  FrameData &frame = get_current_frame();
+  // the slot was last used _framesInFlight frames ago, that frame has to be
+  // done before its resources are reused
+  if (frame_value() > _framesInFlight) {
+    PROFILE_SCOPE("wait for frame");
+    wait_for_frame(frame_value() - _framesInFlight);
+  }
+  // later frames may be done too, whatever they retired can go
+  const uint64_t completed = completed_frame_value();
+  _retireQueue->collect(completed);
+  _bindless->collect(completed);
+  frame._transient->reset();
+  _memoryStats->update(static_cast<uint32_t>(_frameNumber));
 
   // request image from the swapchain
   uint32_t swapchainImageIndex{};
 
-  VkResult e = vkAcquireNextImageKHR(_device, _swapchain, 1000000000,
-                                     frame._swapchainSemaphore, nullptr,
-                                     &swapchainImageIndex);
-  if (e == VK_ERROR_OUT_OF_DATE_KHR) {
-    _resize_requested = true;
-    return;
+  if (!_config.headless) {
+    PROFILE_SCOPE("acquire image");
+    VkResult e = vkAcquireNextImageKHR(_device, _swapchain->handle(),
+                                       NO_TIMEOUT, frame._swapchainSemaphore,
+                                       nullptr, &swapchainImageIndex);
+    if (e == VK_ERROR_OUT_OF_DATE_KHR) {
+      // nothing was submitted, the next try records the same frame value
+      _resize_requested = true;
+      return;
+    }
+    if (e == VK_SUBOPTIMAL_KHR) {
+      // still presentable, recreate after this frame
+      _resize_requested = true;
+    } else {
+      vk_check(e);
+    }
   }
-  vk_check(e);
 
-  vk_check(vkResetCommandBuffer(frame._mainCommandBuffer, 0));
-
-  VkCommandBuffer cmd = frame._mainCommandBuffer;
-
-  VkCommandBufferBeginInfo cmdBeginInfo = vkini::command_buffer_begin_info(
-      VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  // the wait above means this slot's timestamps from _framesInFlight frames
+  // ago are ready
+  _gpuProfiler->begin_frame(frame_slot());
 
+  // the draw image can be larger than the window, see resize_swapchain
   _drawExtent.width = _drawImage.extent.width;
   _drawExtent.height = _drawImage.extent.height;
+  if (!_config.headless) {
+    _drawExtent.width = std::min(_drawExtent.width, _swapchain->extent().width);
+    _drawExtent.height =
+        std::min(_drawExtent.height, _swapchain->extent().height);
+  }
+  // the pass writing the output, the swapchain semaphore waits on the first
+  // stage it touches the output in
+  const char *outputPass = _composite ? "composite" : "present copy";
+  const VkPipelineStageFlags2 presentStage =
+      _composite ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+                 : VK_PIPELINE_STAGE_2_BLIT_BIT;
+
+  // render into the top left of it, presenting scales it up. the frame scope
+  // would also count waiting for the swapchain image, under fifo that is
+  // waiting for vsync, and so would the output pass
+  if (_dynamicResolution) {
+    _dynamicResolution->update(_gpuProfiler->latest_passes(outputPass));
+    _drawExtent = _dynamicResolution->scaled(_drawExtent);
+  }
 
-  vk_check(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+  RenderGraph &graph = *_renderGraph;
+  graph.reset(frame_slot());
 
   // we will overwrite it all so we dont care about what was the older layout
-  vkutil::transition_image(cmd, _drawImage.image, VK_IMAGE_LAYOUT_UNDEFINED,
-                           VK_IMAGE_LAYOUT_GENERAL);
-
-  draw_background(cmd);
-
-  vkutil::transition_image(cmd, _drawImage.image, VK_IMAGE_LAYOUT_GENERAL,
-                           VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL);
-
-  draw_geometry(cmd);
-
-  vkutil::transition_image(cmd, _drawImage.image,
-                           VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL,
-                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-  vkutil::transition_image(cmd, _swapchainImages[swapchainImageIndex],
-                           VK_IMAGE_LAYOUT_UNDEFINED,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-  vkutil::copy_image_to_image(cmd, _drawImage.image,
-                              _swapchainImages[swapchainImageIndex],
-                              _drawExtent, _swapchainExtent);
-
-  vkutil::transition_image(cmd, _swapchainImages[swapchainImageIndex],
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+  ImageHandle draw = graph.import_image(
+      _drawImage.image, _drawImage.view, _drawImage.format,
+      {_drawImage.extent.width, _drawImage.extent.height},
+      VK_IMAGE_LAYOUT_UNDEFINED, presentStage, VK_IMAGE_LAYOUT_UNDEFINED);
+
+  // headless targets are never presented, they stay as they are
+  ImageHandle target{};
+  if (_config.headless) {
+    target = graph.import_image(
+        _headlessTarget.image, _headlessTarget.view, _headlessTarget.format,
+        {_headlessTarget.extent.width, _headlessTarget.extent.height},
+        VK_IMAGE_LAYOUT_UNDEFINED, presentStage, VK_IMAGE_LAYOUT_UNDEFINED);
+  } else {
+    target = graph.import_image(
+        _swapchain->images()[swapchainImageIndex],
+        _swapchain->views()[swapchainImageIndex], _swapchain->format(),
+        _swapchain->extent(), VK_IMAGE_LAYOUT_UNDEFINED, presentStage,
+        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+  }
 
-  vk_check(vkEndCommandBuffer(cmd));
+  // depth is only needed within the frame. sized like the whole draw image
+  // rather than _drawExtent so dynamic resolution doesn't recreate it
+  ImageHandle depth = graph.create_image(
+      DEPTH_FORMAT, {_drawImage.extent.width, _drawImage.extent.height});
+
+  // the pyramid follows the draw image, like depth
+  _drawCulling->resize({_drawImage.extent.width, _drawImage.extent.height});
+  prepare_geometry();
+  const bool depthReadOnly =
+      _prepassDraws != 0 && _prepassDraws == _drawContext.objects.size();
+
+  // the slot's previous frame was the last to use its commands
+  DrawCulling &culling = *_drawCulling;
+  BufferHandle commands = graph.import_buffer(culling.commands(), 0);
+  ImageHandle pyramid = graph.import_image(
+      culling.pyramid(), culling.pyramid_view(), VK_FORMAT_R32_SFLOAT,
+      culling.pyramid_extent(),
+      culling.pyramid_valid() ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                              : VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  graph
+      .add_pass("background",
+                [this](VkCommandBuffer cmd) { draw_background(cmd); })
+      .use(draw, ImageAccess::TransferDst);
+
+  auto add_phase = [&](CullPhase phase) {
+    const bool early = phase == CullPhase::Early;
+
+    graph
+        .add_pass(early ? "cull" : "cull (late)",
+                  [this, phase](VkCommandBuffer cmd) {
+                    _drawCulling->record_cull(cmd, phase);
+                  })
+        .use(pyramid, ImageAccess::Sampled)
+        .use(commands, early ? BufferAccess::ComputeWrite
+                             : BufferAccess::ComputeReadWrite)
+        .async();
+
+    if (_prepassDraws != 0) {
+      graph
+          .add_pass(early ? "depth prepass" : "depth prepass (late)",
+                    [this, depth, phase](VkCommandBuffer cmd) {
+                      draw_depth_prepass(cmd, _renderGraph->view(depth),
+                                         phase);
+                    })
+          .use(depth, ImageAccess::DepthAttachment)
+          .use(commands, BufferAccess::IndirectRead);
+    }
 
-  VkCommandBufferSubmitInfo cmdinfo = vkini::command_buffer_submit_info(cmd);
+    const char *name = _uberShaders ? (early ? "geometry (uber)"
+                                             : "geometry (uber, late)")
+                                    : (early ? "geometry" : "geometry (late)");
+    graph
+        .add_pass(name,
+                  [this, depth, depthReadOnly, phase](VkCommandBuffer cmd) {
+                    draw_geometry(cmd, _renderGraph->view(depth),
+                                  depthReadOnly, phase);
+                  })
+        .use(draw, ImageAccess::ColorAttachment)
+        .use(depth, depthReadOnly ? ImageAccess::DepthRead
+                                  : ImageAccess::DepthAttachment)
+        .use(commands, BufferAccess::IndirectRead);
+  };
+
+  add_phase(CullPhase::Early);
+  if (culling.occlusion()) {
+    graph
+        .add_pass("hi-z",
+                  [this, depth](VkCommandBuffer cmd) {
+                    _drawCulling->record_pyramid(
+                        cmd, _renderGraph->view(depth), _drawExtent);
+                  })
+        .use(depth, ImageAccess::Sampled)
+        .use(pyramid, ImageAccess::ComputeWrite)
+        .async();
+    add_phase(CullPhase::Late);
+  }
 
-  VkSemaphoreSubmitInfo waitInfo = vkini::semaphore_submit_info(
-      VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
-      frame._swapchainSemaphore);
-  VkSemaphoreSubmitInfo signalInfo = vkini::semaphore_submit_info(
-      VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, frame._renderSemaphore);
+  if (_composite) {
+    graph
+        .add_pass(outputPass,
+                  [this, target](VkCommandBuffer cmd) {
+                    _composite->record(cmd, frame_slot(),
+                                       _drawImage.view, _drawExtent,
+                                       _renderGraph->view(target),
+                                       _renderGraph->extent(target));
+                  })
+        .use(draw, ImageAccess::ComputeRead)
+        .use(target, ImageAccess::ComputeWrite);
+  } else {
+    graph
+        .add_pass(outputPass,
+                  [this, target](VkCommandBuffer cmd) {
+                    vkutil::copy_image_to_image(
+                        cmd, _drawImage.image, _renderGraph->image(target),
+                        _drawExtent, _renderGraph->extent(target));
+                  })
+        .use(draw, ImageAccess::TransferSrc)
+        .use(target, ImageAccess::TransferDst);
+  }
 
-  VkSubmitInfo2 submit = vkini::submit_info(&cmdinfo, &signalInfo, &waitInfo);
+  graph.compile();
+
+  // spans every batch of the frame, on both queues
+  uint32_t frameScope{};
+  graph.execute(
+      &*_gpuProfiler,
+      [this, &frameScope](VkCommandBuffer cmd) {
+        frameScope = _gpuProfiler->begin(cmd, "frame");
+      },
+      [this, &frameScope](VkCommandBuffer cmd) {
+        _gpuProfiler->end(cmd, frameScope);
+      });
+  frame._transient->flush();
+
+  // completes the frame's value on the timeline, after the binary render
+  // semaphore when presenting
+  std::array<VkSemaphoreSubmitInfo, 2> signalInfos{
+      vkini::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                   _frameTimeline),
+      vkini::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                   frame._renderSemaphore)};
+  signalInfos[0].value = frame_value();
+
+  if (_config.headless) {
+    // nothing to present, the timeline is all the synchronization we need
+    graph.submit({}, std::span(signalInfos).first(1));
+    _frameNumber++;
+    return;
+  }
 
-  vk_check(vkQueueSubmit2(_graphicsQueue, 1, &submit, frame._renderFence));
+  // the swapchain image is first touched by whatever writes it, everything
+  // before can run while it is still being presented. the graph's last
+  // batch does, on the graphics queue
+  VkSemaphoreSubmitInfo waitInfo =
+      vkini::semaphore_submit_info(presentStage, frame._swapchainSemaphore);
+  graph.submit(std::span(&waitInfo, 1), signalInfos);
 
   VkPresentInfoKHR presentInfo = vkini::present_info();
 
-  presentInfo.pSwapchains = &_swapchain;
+  VkSwapchainKHR swapchain = _swapchain->handle();
+  presentInfo.pSwapchains = &swapchain;
   presentInfo.swapchainCount = 1;
 
   presentInfo.pWaitSemaphores = &frame._renderSemaphore;
@@ -646,7 +1082,14 @@ void Engine::draw() {
 
   presentInfo.pImageIndices = &swapchainImageIndex;
 
+  PROFILE_SCOPE("present");
   VkResult presentResult = vkQueuePresentKHR(_graphicsQueue, &presentInfo);
+  if (presentResult == VK_ERROR_OUT_OF_DATE_KHR ||
+      presentResult == VK_SUBOPTIMAL_KHR) {
+    _resize_requested = true;
+  } else {
+    vk_check(presentResult);
+  }
   // increase the number of frames drawn
   _frameNumber++;
 }
@@ -661,20 +1104,129 @@ void Engine::draw_background(VkCommandBuffer cmd) {
   VkImageSubresourceRange clearRange =
       vkini::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
 
-  vkCmdClearColorImage(cmd, _drawImage.image, VK_IMAGE_LAYOUT_GENERAL,
+  vkCmdClearColorImage(cmd, _drawImage.image,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                        &clearValue, 1, &clearRange);
 }
 
-void Engine::draw_geometry(VkCommandBuffer cmd) {
-  // begin a render pass  connected to our draw image
+void Engine::prepare_geometry() {
+  PROFILE_SCOPE("prepare_geometry");
+
+  _drawContext.objects.clear();
+
+  // _triangle->draw(_drawContext);
+  _vikingRoom->draw(_drawContext);
+
+  _prepassDraws = static_cast<size_t>(std::ranges::count_if(
+      _drawContext.objects, [](const RenderObject &object) {
+        return object.depthPipeline != VK_NULL_HANDLE;
+      }));
+
+  FrameData &frame = get_current_frame();
+  // the matrices are only recomputed when the extent changed
+  _camera.set_aspect(float(_drawExtent.width) / float(_drawExtent.height));
+  const TransientAllocation camera =
+      frame._transient->push<CameraData>({&_camera.data(), 1});
+  _drawCulling->begin_frame(frame_slot(), _drawContext.objects,
+                            camera.address, *frame._transient);
+
+  // don't bother waking workers for a handful of draws
+  constexpr size_t MIN_DRAWS_PER_WORKER = 256;
+
+  const size_t drawCount = _drawContext.objects.size();
+  const size_t workerCount = std::clamp<size_t>(
+      drawCount / MIN_DRAWS_PER_WORKER, 1, _recordWorkers);
+  const size_t chunkSize = (drawCount + workerCount - 1) / workerCount;
+
+  std::span<const RenderObject> objects = _drawContext.objects;
+
+  auto record_chunk = [&](size_t i) {
+    size_t first = std::min(i * chunkSize, drawCount);
+    size_t count = std::min(chunkSize, drawCount - first);
+    record_geometry(frame._workerCommands[i], objects.subspan(first, count),
+                    first);
+  };
+
+  _jobs.parallel_for(workerCount, 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      record_chunk(i);
+    }
+  });
+
+  _geometryWorkers = workerCount;
+}
+
+void Engine::draw_depth_prepass(VkCommandBuffer cmd, VkImageView depth,
+                                CullPhase phase) {
+  FrameData &frame = get_current_frame();
+  const std::vector<VkCommandBuffer> &secondaries =
+      frame._prepassSecondaries[static_cast<size_t>(phase)];
+
+  VkRenderingAttachmentInfo depthAttachment = vkini::depth_attachment_info(
+      depth, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+  if (phase == CullPhase::Late) {
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+  }
+
+  VkRenderingInfo renderInfo =
+      vkini::rendering_info(_drawExtent, nullptr, &depthAttachment);
+  renderInfo.colorAttachmentCount = 0;
+  renderInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+  vkCmdBeginRendering(cmd, &renderInfo);
+
+  vkCmdExecuteCommands(cmd, static_cast<uint32_t>(_geometryWorkers),
+                       secondaries.data());
+
+  vkCmdEndRendering(cmd);
+}
+
+void Engine::draw_geometry(VkCommandBuffer cmd, VkImageView depth,
+                           bool depthReadOnly, CullPhase phase) {
+  FrameData &frame = get_current_frame();
+  const std::vector<VkCommandBuffer> &secondaries =
+      frame._geometrySecondaries[static_cast<size_t>(phase)];
+
+  // begin a render pass  connected to our draw image. all of its contents come
+  // from the secondary command buffers
   VkRenderingAttachmentInfo colorAttachment = vkini::attachment_info(
       _drawImage.view, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
+  // keeps what the prepass or the early phase wrote. the hi-z pyramid is
+  // built from the early phase's depth, nothing reads it after that
+  VkRenderingAttachmentInfo depthAttachment = vkini::depth_attachment_info(
+      depth, depthReadOnly ? VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL
+                           : VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+  if (_prepassDraws != 0 || phase == CullPhase::Late) {
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+  }
+  const bool depthNeeded =
+      phase == CullPhase::Early && _drawCulling->occlusion();
+  if (depthReadOnly) {
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_NONE;
+  } else {
+    depthAttachment.storeOp = depthNeeded ? VK_ATTACHMENT_STORE_OP_STORE
+                                          : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  }
+
   VkRenderingInfo renderInfo =
-      vkini::rendering_info(_drawExtent, &colorAttachment, nullptr);
+      vkini::rendering_info(_drawExtent, &colorAttachment, &depthAttachment);
+  renderInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
   vkCmdBeginRendering(cmd, &renderInfo);
 
-  // set dynamic viewport and scissor
+  vkCmdExecuteCommands(cmd, static_cast<uint32_t>(_geometryWorkers),
+                       secondaries.data());
+
+  vkCmdEndRendering(cmd);
+}
+
+void Engine::record_geometry(WorkerCommands &worker,
+                             std::span<const RenderObject> objects,
+                             size_t firstDraw) {
+  PROFILE_SCOPE("record_geometry");
+
+  vk_check(vkResetCommandPool(_device, worker._commandPool, 0));
+
+  // dynamic state is not inherited, set it per secondary
   VkViewport viewport = {};
   viewport.x = 0;
   viewport.y = 0;
@@ -683,21 +1235,60 @@ void Engine::draw_geometry(VkCommandBuffer cmd) {
   viewport.minDepth = 0.;
   viewport.maxDepth = 1.;
 
-  vkCmdSetViewport(cmd, 0, 1, &viewport);
-
   VkRect2D scissor = {};
   scissor.offset.x = 0;
   scissor.offset.y = 0;
   scissor.extent.width = _drawExtent.width;
   scissor.extent.height = _drawExtent.height;
 
-  vkCmdSetScissor(cmd, 0, 1, &scissor);
+  auto record = [&](VkCommandBuffer cmd, CullPhase phase, bool depthPrepass) {
+    VkCommandBufferInheritanceRenderingInfo inheritanceRendering{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO};
+    // the prepass renders depth only
+    if (!depthPrepass) {
+      inheritanceRendering.colorAttachmentCount = 1;
+      inheritanceRendering.pColorAttachmentFormats = &_drawImage.format;
+    }
+    inheritanceRendering.depthAttachmentFormat = DEPTH_FORMAT;
+    inheritanceRendering.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceInfo inheritance{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    inheritance.pNext = &inheritanceRendering;
+    // executed inside the render graph's statistics query
+    if (_gpuProfiler->pipeline_statistics()) {
+      inheritance.pipelineStatistics = GpuProfiler::STATISTICS_FLAGS;
+    }
 
-  // _triangle->draw(cmd);
-  _vikingRoom->draw(cmd);
-  // _monkeyHead->draw(cmd);
+    VkCommandBufferBeginInfo cmdBeginInfo = vkini::command_buffer_begin_info(
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+        VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+    cmdBeginInfo.pInheritanceInfo = &inheritance;
 
-  vkCmdEndRendering(cmd);
+    vk_check(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+    // the slice's commands start at its first object's
+    IndirectDraws indirect = _drawCulling->indirect(phase);
+    indirect.offset += firstDraw * sizeof(VkDrawIndexedIndirectCommand);
+    record_draws(cmd, objects, *_bindless, indirect, depthPrepass);
+
+    vk_check(vkEndCommandBuffer(cmd));
+  };
+
+  // every worker's prepass buffer is executed, even if its slice has no
+  // prepass draws. the late phase draws the same objects, its commands
+  // decide which actually get instances
+  const uint32_t phases = _drawCulling->occlusion() ? CULL_PHASES : 1;
+  for (uint32_t i = 0; i < phases; i++) {
+    const auto phase = static_cast<CullPhase>(i);
+    if (_prepassDraws != 0) {
+      record(worker._prepassCommandBuffers[i], phase, true);
+    }
+    record(worker._geometryCommandBuffers[i], phase, false);
+  }
 }
 
 void Engine::immediate_submit(
@@ -719,8 +1310,8 @@ void Engine::immediate_submit(
   VkSubmitInfo2 submit = vkini::submit_info(&cmdinfo, nullptr, nullptr);
 
   // submit command buffer to the queue and execute it.
-  //  _renderFence will now block until the graphic commands finish execution
+  //  _immFence will now block until the graphic commands finish execution
   vk_check(vkQueueSubmit2(_graphicsQueue, 1, &submit, _immFence));
 
-  vk_check(vkWaitForFences(_device, 1, &_immFence, true, 9999999999));
+  vk_check(vkWaitForFences(_device, 1, &_immFence, true, NO_TIMEOUT));
 }
@@ -1,8 +1,7 @@
 ﻿#pragma once
 
-#include <tiny_obj_loader.h>
 #include <vk_mem_alloc.h>
-#include <vulkan/vulkan.h>
+#include <volk.h>
 
 #include <array>
 #include <deque>
@@ -11,13 +10,30 @@
 #include <optional>
 #include <ranges>
 #include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 
-#include "monkey_head.hpp"
+#include "bindless.hpp"
+#include "camera.hpp"
+#include "composite.hpp"
+#include "deletion_queue.hpp"
+#include "draw_culling.hpp"
+#include "dynamic_resolution.hpp"
+#include "engine_config.hpp"
+#include "gpu_profiler.hpp"
+#include "job_system.hpp"
+#include "linear_allocator.hpp"
+#include "memory_stats.hpp"
 #include "object.hpp"
+#include "render_graph.hpp"
+#include "render_object.hpp"
 #include "struct.hpp"
 #include "viking_room.hpp"
+#include "vulkan/swapchain.hpp"
 
+// cleanup callbacks for init and shutdown. resources released while
+// rendering go through Engine::retire instead, which doesn't allocate
 struct DeletionQueue {
   std::deque<std::function<void()>> deletors;
 
@@ -34,22 +50,44 @@ struct DeletionQueue {
   }
 };
 
+// command pool for one slice of the draw list, only ever recorded from one
+// job at a time
+struct WorkerCommands {
+  VkCommandPool _commandPool;
+  // the slice's draws of each CullPhase, only the early ones are used without
+  // occlusion culling
+  std::array<VkCommandBuffer, CULL_PHASES> _geometryCommandBuffers;
+  // the slice's draws in the depth prepass
+  std::array<VkCommandBuffer, CULL_PHASES> _prepassCommandBuffers;
+};
+
 struct FrameData {
   VkSemaphore _swapchainSemaphore, _renderSemaphore;
-  VkFence _renderFence;
 
-  DeletionQueue _deletionQueue;
-  VkDescriptorSet _descriptorSet;
+  // gpu data written for this frame only, reset once the frame retired
+  std::optional<LinearAllocator> _transient;
 
-  VkCommandPool _commandPool;
-  VkCommandBuffer _mainCommandBuffer;
+  std::vector<WorkerCommands> _workerCommands;
+  // the same secondaries gathered per CullPhase in worker order, filled once
+  // so each pass executes the first _geometryWorkers without copying them
+  std::array<std::vector<VkCommandBuffer>, CULL_PHASES> _geometrySecondaries;
+  std::array<std::vector<VkCommandBuffer>, CULL_PHASES> _prepassSecondaries;
 };
 
-constexpr unsigned int FRAME_OVERLAP = 2;
+// of the depth buffer, which is cleared to 0 and tested with GREATER since
+// depth is reversed, see vkutil::perspective_reverse_z
+constexpr VkFormat DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+
+// decoded rgba8 pixels, freed by whoever uploads them
+struct ImagePixels {
+  unsigned char *data;
+  int width;
+  int height;
+};
 
 class Engine {
  public:
-  Engine();
+  explicit Engine(EngineConfig config = {});
   Engine(const Engine &) = delete;
   Engine(Engine &&) = delete;
   Engine &operator=(const Engine &) = delete;
@@ -62,11 +100,42 @@ class Engine {
   // run main loop
   void run();
 
+  // renders one frame. public so benchmarks can drive and time single frames
+  void draw();
+
+  // relative to _config.assetDir
+  [[nodiscard]] std::string asset_path(std::string_view relative) const;
+
   [[nodiscard]] GPUMeshBuffers upload_mesh(std::span<const Vertex> vertices,
                                            std::span<const uint32_t> indices);
 
   FrameData &get_current_frame();
 
+  // index of the per frame resources the frame being recorded uses, below
+  // _framesInFlight
+  [[nodiscard]] uint32_t frame_slot() const {
+    return static_cast<uint32_t>(_frameNumber) % _framesInFlight;
+  }
+
+  // timeline value of the frame being recorded. _frameTimeline reaches it
+  // once that frame's submission finished
+  [[nodiscard]] uint64_t frame_value() const {
+    return static_cast<uint64_t>(_frameNumber) + 1;
+  }
+
+  // highest frame value the gpu finished, queried from _frameTimeline
+  uint64_t completed_frame_value();
+
+  // blocks until the gpu finished the frame with value and everything
+  // submitted before it. returns right away for frames known to be done
+  void wait_for_frame(uint64_t value);
+
+  // destroys handle once the gpu finished the current frame
+  template <typename T>
+  void retire(T handle, VmaAllocation allocation = nullptr) {
+    _retireQueue->retire(handle, frame_value(), allocation);
+  }
+
  private:
   // initializes everything in the engine
   void init();
@@ -82,38 +151,75 @@ class Engine {
 
   void init_sync_structures();
 
-  void init_descriptor_set_layouts();
+  void init_bindless();
 
   void init_pipelines();
 
-  void init_texture_image();
+  void init_texture_image(ImagePixels pixels);
 
   void init_texture_sampler();
 
   void init_default_data();
 
-  void init_descriptor_pools();
+  // creates _swapchain for _windowExtent, replacing and retiring the current
+  // one if there is one
+  void create_swapchain();
 
-  void init_descriptor_sets();
+  // recreates the swapchain for the window's current size without waiting
+  // for the gpu, growing _drawImage if needed
+  void resize_swapchain();
 
-  void create_swapchain(uint32_t width, uint32_t height);
+  void create_draw_image(VkExtent2D extent);
 
-  void destroy_swapchain();
+  void create_headless_target();
 
-  // draw loop
-  void draw();
+  // draws _config.headlessFrames frames without a window and reports the
+  // average frame time
+  void run_headless();
+
+  // writes the cpu profiler trace to _config.tracePath
+  void write_trace();
+
+  // writes _memoryStats as json to _config.memoryReportPath
+  void write_memory_report();
 
   void draw_background(VkCommandBuffer cmd);
 
-  void draw_geometry(VkCommandBuffer cmd);
+  // fills the draw context, uploads it for culling and records it into the
+  // workers' secondary buffers, before the passes executing them
+  void prepare_geometry();
+
+  // lays down the depth of the objects drawn in the prepass. the late phase
+  // adds to the early one's depth
+  void draw_depth_prepass(VkCommandBuffer cmd, VkImageView depth,
+                          CullPhase phase);
+
+  // depthReadOnly when every object was drawn in the depth prepass
+  void draw_geometry(VkCommandBuffer cmd, VkImageView depth,
+                     bool depthReadOnly, CullPhase phase);
+
+  // records one slice of the draw context, starting at firstDraw, into the
+  // worker's secondary buffers
+  void record_geometry(WorkerCommands &worker,
+                       std::span<const RenderObject> objects, size_t firstDraw);
 
   void immediate_submit(std::function<void(VkCommandBuffer cmd)> &&function);
 
  public:
+  EngineConfig _config;
+
+  // created first, everything else may use it during init
+  JobSystem _jobs;
+
   bool _isInitialized{false};
   int _frameNumber{0};
   bool _resize_requested{false};
   bool _freeze_rendering{false};
+  // draw with the runtime branching uber pipelines instead of the specialized
+  // material variants
+  bool _uberShaders{false};
+  // draw the objects whose materials ask for it in a depth prepass first
+  bool _depthPrepass{false};
 
   VkExtent2D _windowExtent{1700, 900};
 
@@ -126,36 +232,75 @@ class Engine {
 
   VkQueue _graphicsQueue{};
   uint32_t _graphicsQueueFamily{};
+  // null without EngineConfig::asyncCompute or a separate compute family
+  VkQueue _computeQueue{};
+  uint32_t _computeQueueFamily{};
+
+  // frames the cpu records ahead of the gpu, see EngineConfig
+  uint32_t _framesInFlight{2};
+  // _framesInFlight of them, frame_slot() picks the current one
+  std::vector<FrameData> _frames;
+  // signaled with frame_value() by every frame's submission
+  VkSemaphore _frameTimeline{};
+
+  // number of slices the draw list is split into for parallel recording
+  uint32_t _recordWorkers{1};
 
-  std::array<FrameData, FRAME_OVERLAP> _frames{};
+  // looks at the scene from above one corner, objects draw relative to it
+  Camera _camera{glm::vec3(2.F), glm::vec3(0.F), glm::vec3(0.F, 0.F, 1.F)};
+
+  DrawContext _drawContext;
+  // objects of _drawContext with a depth prepass pipeline
+  size_t _prepassDraws{0};
+  // slices _drawContext was recorded in this frame
+  size_t _geometryWorkers{1};
+
+  std::optional<GpuProfiler> _gpuProfiler;
+  // only with a gpu budget configured
+  std::optional<DynamicResolution> _dynamicResolution;
 
   VkSurfaceKHR _surface{};
-  VkSwapchainKHR _swapchain{};
-  VkFormat _swapchainImageFormat{};
-  VkExtent2D _swapchainExtent{};
+  std::optional<Swapchain> _swapchain;
+  // stands in for the swapchain when headless, so presenting is measured too
+  AllocatedImage _headlessTarget{};
+  // part of _drawImage rendered to this frame
   VkExtent2D _drawExtent{};
-  VkDescriptorPool _descriptorPool{};
-
-  std::vector<VkImage> _swapchainImages;
-  std::vector<VkImageView> _swapchainImageViews;
 
   DeletionQueue _mainDeletionQueue{};
 
   VmaAllocator _allocator{};
+  std::optional<RetireQueue> _retireQueue;
+  // highest frame value the gpu is known to have finished
+  uint64_t _completedFrameValue{0};
+  std::optional<MemoryStats> _memoryStats;
 
   AllocatedImage _drawImage{};
 
+  // tonemaps and upscales _drawImage into the swapchain, without it the
+  // frame is blitted
+  std::optional<Composite> _composite;
+
+  // the passes of the frame, rebuilt every draw
+  std::optional<RenderGraph> _renderGraph;
+
+  // writes the indirect draws of _drawContext, occlusion culled if
+  // configured
+  std::optional<DrawCulling> _drawCulling;
+
   VkFence _immFence{};
   VkCommandBuffer _immCommandBuffer{};
   VkCommandPool _immCommandPool{};
 
   std::optional<TriangleObject> _triangle;
   std::optional<VikingRoom> _vikingRoom;
-  std::optional<MonkeyHead> _monkeyHead;
+
+  // every texture and sampler, bound once per command buffer
+  std::optional<BindlessTable> _bindless;
+  DescriptorBackend _descriptorBackend{DescriptorBackend::Pool};
 
   AllocatedImage _textureImage{};
   VkSampler _textureSampler{};
-
-  VkDescriptorSetLayout _descriptorSetLayout{};
-  std::vector<VkDescriptorSet> _descriptorSets;
+  // slots of the texture and sampler in _bindless
+  uint32_t _textureIndex{};
+  uint32_t _samplerIndex{};
 };
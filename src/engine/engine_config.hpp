@@ -0,0 +1,71 @@
+#pragma once
+
+#include <volk.h>
+
+#include <cstdint>
+#include <string>
+
+// upper bound of EngineConfig::framesInFlight
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+// startup options, filled in from the command line in main
+struct EngineConfig {
+  // negotiated against what the surface supports, see set_present_mode
+  VkPresentModeKHR presentMode{VK_PRESENT_MODE_FIFO_KHR};
+  // 0 lets the driver decide
+  uint32_t swapchainImageCount{0};
+  // frames the cpu may record ahead of the gpu, 1 to MAX_FRAMES_IN_FLIGHT.
+  // fewer lower input latency, more keep the gpu busy when frame times vary
+  uint32_t framesInFlight{2};
+  // room per frame in flight for transient gpu data like per draw data, in
+  // MiB. see LinearAllocator
+  uint32_t transientMb{32};
+  // report frames per second, meant for measuring throughput with a
+  // non-blocking present mode
+  bool uncapped{false};
+  // render without a window or swapchain, for machines without a display.
+  // runs for headlessFrames frames and exits
+  bool headless{false};
+  uint32_t headlessFrames{1000};
+  // start with the uber material pipelines instead of the specialized ones
+  bool uberShaders{false};
+  // how many times the scene is drawn, laid out in a grid. anything above 1
+  // is a stress test for draw submission
+  uint32_t drawCopies{1};
+  // where F12 or traceFrames write the cpu profiler trace, empty disables it
+  std::string tracePath;
+  // write the trace automatically after this many frames, 0 for never
+  uint32_t traceFrames{0};
+  // where F11 and the end of a headless run write the gpu memory report
+  std::string memoryReportPath;
+  // keep the bindless table in a VK_EXT_descriptor_buffer instead of a
+  // descriptor set, falls back to the set when the extension is missing
+  bool descriptorBuffer{false};
+  // gpu frame time in milliseconds that dynamic resolution scales the render
+  // extent to stay within, 0 always renders at full resolution
+  double gpuBudgetMs{0.};
+  // copy the frame to the swapchain with a blit instead of the compute
+  // composite, skipping tonemapping and sharpening. also used when the
+  // swapchain can't be written from a compute shader
+  bool blitPresent{false};
+  // draw expensive materials in a depth only pass first, so their fragments
+  // are only shaded once per pixel
+  bool depthPrepass{false};
+  // skip objects hidden behind what was drawn, tested on the gpu against a
+  // hi-z pyramid of the depth buffer
+  bool occlusionCulling{false};
+  // run culling and the hi-z pyramid on a compute queue of its own, next to
+  // the graphics work. without a separate compute queue family everything
+  // stays on the graphics queue
+  bool asyncCompute{false};
+  // call device functions through the loader's trampolines instead of the
+  // pointers volk loads from the device, to measure what that costs
+  bool loaderDispatch{false};
+  // vertex shaders read the vertices through the draw's buffer device
+  // address instead of fixed function vertex input, so draws of different
+  // vertex buffers need no rebinding
+  bool vertexPulling{false};
+  // models and textures are found relative to this. defaults to the source
+  // tree, so the engine and the benchmarks run from any working directory
+  std::string assetDir{ENGINE_ASSET_DIR};
+};
@@ -5,6 +5,7 @@
 
 #include <fastgltf/core.hpp>
 
+#include "cpu_profiler.hpp"
 #include "engine.hpp"
 #include "spdlog/spdlog.h"
 
@@ -124,6 +125,7 @@ VkSamplerMipmapMode extract_mipmap_mode(fastgltf::Filter filter)
 }
 
 std::unique_ptr<Scene> Scene::load(std::string_view filePath) {
+  PROFILE_SCOPE("Scene::load");
   Engine& engine = Engine::instance();
   fmt::print("Loading GLTF: {}", filePath);
 
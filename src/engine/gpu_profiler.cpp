@@ -0,0 +1,280 @@
+#include "gpu_profiler.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <numeric>
+
+#include "helpers.hpp"
+
+namespace {
+
+// marks a scope whose queries didn't fit into the pool
+constexpr uint32_t NO_QUERY = ~0U;
+
+}  // namespace
+
+GpuProfiler::GpuProfiler(VkDevice device, VkPhysicalDevice gpu,
+                         std::span<const uint32_t> queueFamilies,
+                         uint32_t frameCount, bool pipelineStatistics)
+    : _device{device}, _frames(frameCount) {
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(gpu, &properties);
+  _timestampPeriod = properties.limits.timestampPeriod;
+
+  uint32_t familyCount{0};
+  vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, families.data());
+
+  // scopes only ever compare timestamps of the same queue, the fewest valid
+  // bits of all of them do
+  uint32_t validBits{64};
+  for (uint32_t queueFamily : queueFamilies) {
+    const uint32_t bits = families.at(queueFamily).timestampValidBits;
+    if (bits == 0) {
+      fmt::print("queue family {} has no timestamps, gpu profiler disabled\n",
+                 queueFamily);
+      _enabled = false;
+      return;
+    }
+    validBits = std::min(validBits, bits);
+  }
+  if (validBits < 64) {
+    _timestampMask = (1ULL << validBits) - 1;
+  }
+
+  VkQueryPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = MAX_QUERIES;
+
+  for (FrameQueries &frame : _frames) {
+    vk_check(vkCreateQueryPool(_device, &poolInfo, nullptr, &frame.pool));
+    vkResetQueryPool(_device, frame.pool, 0, MAX_QUERIES);
+    frame.scopes.reserve(MAX_QUERIES / 2);
+  }
+  _results.resize(MAX_QUERIES);
+  _latestFrame.reserve(MAX_QUERIES / 2);
+
+  if (!pipelineStatistics) {
+    return;
+  }
+  _pipelineStatistics = true;
+
+  VkQueryPoolCreateInfo statisticsInfo{};
+  statisticsInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  statisticsInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+  statisticsInfo.queryCount = MAX_STATISTICS_QUERIES;
+  statisticsInfo.pipelineStatistics = STATISTICS_FLAGS;
+
+  for (FrameQueries &frame : _frames) {
+    vk_check(vkCreateQueryPool(_device, &statisticsInfo, nullptr,
+                               &frame.statisticsPool));
+    vkResetQueryPool(_device, frame.statisticsPool, 0, MAX_STATISTICS_QUERIES);
+  }
+}
+
+GpuProfiler::~GpuProfiler() {
+  for (FrameQueries &frame : _frames) {
+    vkDestroyQueryPool(_device, frame.pool, nullptr);
+    vkDestroyQueryPool(_device, frame.statisticsPool, nullptr);
+  }
+}
+
+void GpuProfiler::begin_frame(uint32_t frameSlot) {
+  _current = &_frames.at(frameSlot);
+  _depth = 0;
+
+  if (!_enabled) {
+    return;
+  }
+
+  collect(*_current);
+}
+
+uint32_t GpuProfiler::begin(VkCommandBuffer cmd, const char *name) {
+  if (!_enabled || _current->queryCount + 2 > MAX_QUERIES) {
+    return NO_QUERY;
+  }
+
+  const auto scope = static_cast<uint32_t>(_current->scopes.size());
+  const uint32_t query = _current->queryCount;
+  _current->queryCount += 2;
+
+  _current->scopes.push_back(Scope{
+      .name = name,
+      .depth = _depth++,
+      .beginQuery = query,
+      .endQuery = query + 1,
+  });
+
+  vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
+                       _current->pool, query);
+  return scope;
+}
+
+void GpuProfiler::end(VkCommandBuffer cmd, uint32_t scope) {
+  if (scope == NO_QUERY) {
+    return;
+  }
+
+  _depth--;
+  vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT,
+                       _current->pool, _current->scopes[scope].endQuery);
+}
+
+void GpuProfiler::begin_statistics(VkCommandBuffer cmd) {
+  if (!_pipelineStatistics ||
+      _current->statisticsCount == MAX_STATISTICS_QUERIES) {
+    return;
+  }
+  vkCmdBeginQuery(cmd, _current->statisticsPool, _current->statisticsCount,
+                  0);
+  _current->statisticsActive = true;
+}
+
+void GpuProfiler::end_statistics(VkCommandBuffer cmd) {
+  if (!_current->statisticsActive) {
+    return;
+  }
+  vkCmdEndQuery(cmd, _current->statisticsPool, _current->statisticsCount++);
+  _current->statisticsActive = false;
+}
+
+void GpuProfiler::collect(FrameQueries &frame) {
+  if (frame.statisticsCount != 0) {
+    vk_check(vkGetQueryPoolResults(
+        _device, frame.statisticsPool, 0, frame.statisticsCount,
+        frame.statisticsCount * sizeof(uint64_t), _results.data(),
+        sizeof(uint64_t), VK_QUERY_RESULT_64_BIT));
+    _fragmentInvocations += std::accumulate(
+        _results.begin(),
+        _results.begin() + static_cast<std::ptrdiff_t>(frame.statisticsCount),
+        uint64_t{0});
+    _statisticsFrames++;
+
+    // queries have to be reset before they are written again
+    vkResetQueryPool(_device, frame.statisticsPool, 0, frame.statisticsCount);
+    frame.statisticsCount = 0;
+  }
+
+  if (frame.queryCount == 0) {
+    return;
+  }
+
+  // the slot's timeline value was waited on, so the results are all there.
+  // don't pass WAIT, a missing result should show up as an error rather than
+  // a stall
+  vk_check(vkGetQueryPoolResults(
+      _device, frame.pool, 0, frame.queryCount,
+      frame.queryCount * sizeof(uint64_t), _results.data(), sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT));
+
+  _latestFrame.clear();
+  for (const Scope &scope : frame.scopes) {
+    const uint64_t begin = _results[scope.beginQuery] & _timestampMask;
+    const uint64_t end = _results[scope.endQuery] & _timestampMask;
+    const double ms =
+        static_cast<double>((end - begin) & _timestampMask) * _timestampPeriod *
+        1e-6;
+    _latestFrame.push_back(
+        Sample{.name = scope.name, .depth = scope.depth, .ms = ms});
+
+    // only a scope seen for the first time allocates
+    auto it = _history.find(scope.name);
+    if (it == _history.end()) {
+      it = _history.try_emplace(scope.name).first;
+      _order.emplace_back(scope.name);
+    }
+
+    History &history = it->second;
+    history.depth = scope.depth;
+    history.samples[history.next] = ms;
+    history.next = (history.next + 1) % HISTORY;
+    history.count = std::min(history.count + 1, HISTORY);
+  }
+
+  vkResetQueryPool(_device, frame.pool, 0, frame.queryCount);
+  frame.scopes.clear();
+  frame.queryCount = 0;
+}
+
+std::vector<GpuScopeStats> GpuProfiler::stats() const {
+  std::vector<GpuScopeStats> result;
+  result.reserve(_order.size());
+
+  std::vector<double> sorted;
+  for (const std::string &name : _order) {
+    const History &history = _history.at(name);
+    if (history.count == 0) {
+      continue;
+    }
+
+    sorted.assign(history.samples.begin(),
+                  history.samples.begin() +
+                      static_cast<std::ptrdiff_t>(history.count));
+    std::ranges::sort(sorted);
+
+    const size_t p99 = (sorted.size() * 99) / 100;
+    result.push_back(GpuScopeStats{
+        .name = name,
+        .depth = history.depth,
+        .min = sorted.front(),
+        .avg = std::accumulate(sorted.begin(), sorted.end(), 0.) /
+               static_cast<double>(sorted.size()),
+        .p99 = sorted[std::min(p99, sorted.size() - 1)],
+    });
+  }
+
+  return result;
+}
+
+double GpuProfiler::latest(const char *name) const {
+  auto it = _history.find(name);
+  if (it == _history.end() || it->second.count == 0) {
+    return 0.;
+  }
+
+  const History &history = it->second;
+  return history.samples[(history.next + HISTORY - 1) % HISTORY];
+}
+
+double GpuProfiler::latest_passes(std::string_view exclude) const {
+  double ms = 0.;
+  for (const Sample &sample : _latestFrame) {
+    if (sample.depth == 1 && sample.name != exclude) {
+      ms += sample.ms;
+    }
+  }
+  return ms;
+}
+
+double GpuProfiler::fragment_invocations() const {
+  if (_statisticsFrames == 0) {
+    return 0.;
+  }
+  return static_cast<double>(_fragmentInvocations) /
+         static_cast<double>(_statisticsFrames);
+}
+
+void GpuProfiler::reset() {
+  for (auto &[name, history] : _history) {
+    history.count = 0;
+    history.next = 0;
+  }
+  _fragmentInvocations = 0;
+  _statisticsFrames = 0;
+}
+
+void GpuProfiler::print() const {
+  for (const GpuScopeStats &scope : stats()) {
+    fmt::print("  {:{}}{:<{}} min {:.3f} avg {:.3f} p99 {:.3f} ms\n", "",
+               scope.depth * 2, scope.name, 24 - scope.depth * 2, scope.min,
+               scope.avg, scope.p99);
+  }
+  if (_pipelineStatistics) {
+    fmt::print("  {:<24} {:.0f} per frame\n", "fragment invocations",
+               fragment_invocations());
+  }
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <volk.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// rolling timings of one named scope, in milliseconds
+struct GpuScopeStats {
+  std::string name;
+  // nesting level of the scope the last time it was recorded
+  uint32_t depth;
+  double min;
+  double avg;
+  double p99;
+};
+
+// measures gpu time of named command buffer regions with timestamp queries,
+// and optionally counts fragment shader invocations with pipeline statistics
+// queries. every frame slot has its own query pools, which are read back and
+// reset from the host the next time the slot comes around, so reading never
+// waits on the gpu. a frame may span several command buffers and queues
+class GpuProfiler {
+ public:
+  // number of frames the rolling stats are taken over
+  static constexpr size_t HISTORY = 240;
+  // timestamps per frame, two per scope
+  static constexpr uint32_t MAX_QUERIES = 128;
+  // pipeline statistics queries per frame, one per graphics command buffer
+  static constexpr uint32_t MAX_STATISTICS_QUERIES = 8;
+  // what the statistics queries count
+  static constexpr VkQueryPipelineStatisticFlags STATISTICS_FLAGS =
+      VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+  // queueFamilies are the families scopes are recorded on. the
+  // hostQueryReset feature has to be enabled, pipelineStatistics needs the
+  // pipelineStatisticsQuery and inheritedQueries features
+  GpuProfiler(VkDevice device, VkPhysicalDevice gpu,
+              std::span<const uint32_t> queueFamilies, uint32_t frameCount,
+              bool pipelineStatistics);
+  GpuProfiler(const GpuProfiler &) = delete;
+  GpuProfiler(GpuProfiler &&) = delete;
+  GpuProfiler &operator=(const GpuProfiler &) = delete;
+  GpuProfiler &operator=(GpuProfiler &&) = delete;
+  ~GpuProfiler();
+
+  // collects the results the slot recorded last time and resets its queries.
+  // the slot's previous frame has to be known complete, i.e. its timeline
+  // value waited on
+  void begin_frame(uint32_t frameSlot);
+
+  // returns a handle to pass to end. scopes must nest and name has to stay
+  // alive until the frame is read back, use string literals
+  uint32_t begin(VkCommandBuffer cmd, const char *name);
+  void end(VkCommandBuffer cmd, uint32_t scope);
+
+  // counts the fragment shader invocations in between, outside of rendering
+  // and on a graphics queue. a frame's counts are summed. no-ops without
+  // pipeline statistics or once a frame has MAX_STATISTICS_QUERIES
+  void begin_statistics(VkCommandBuffer cmd);
+  void end_statistics(VkCommandBuffer cmd);
+
+  // stats for every scope seen so far, in the order they were first recorded
+  [[nodiscard]] std::vector<GpuScopeStats> stats() const;
+
+  // most recently read back time of a scope in milliseconds, 0 if it has no
+  // samples. lags frames in flight frames behind recording
+  [[nodiscard]] double latest(const char *name) const;
+
+  // sum of the most recently read back frame's scopes one level below the
+  // outermost, i.e. the render graph's passes, leaving out the one named
+  // exclude. 0 before the first readback. unlike the outermost scope this
+  // doesn't count the gpu idling between submissions or waiting on
+  // semaphores, except within exclude. passes overlapping on different
+  // queues are counted in full
+  [[nodiscard]] double latest_passes(std::string_view exclude) const;
+
+  // average fragment shader invocations per frame since the last reset, 0
+  // without pipeline statistics
+  [[nodiscard]] double fragment_invocations() const;
+
+  void print() const;
+
+  // forgets all samples, e.g. after warming up
+  void reset();
+
+  // false when the queue doesn't support timestamps, scopes are no-ops then
+  [[nodiscard]] bool enabled() const { return _enabled; }
+
+  // whether statistics queries are recorded. secondary command buffers
+  // executed between begin_statistics and end_statistics have to inherit
+  // STATISTICS_FLAGS then, which needs the inheritedQueries feature
+  [[nodiscard]] bool pipeline_statistics() const {
+    return _pipelineStatistics;
+  }
+
+ private:
+  struct Scope {
+    const char *name;
+    uint32_t depth;
+    uint32_t beginQuery;
+    uint32_t endQuery;
+  };
+
+  struct FrameQueries {
+    VkQueryPool pool{};
+    std::vector<Scope> scopes;
+    uint32_t queryCount{0};
+    VkQueryPool statisticsPool{};
+    uint32_t statisticsCount{0};
+    // between begin_statistics and end_statistics, with a query begun
+    bool statisticsActive{false};
+  };
+
+  struct Sample {
+    const char *name;
+    uint32_t depth;
+    double ms;
+  };
+
+  struct History {
+    uint32_t depth{0};
+    // ring of the last HISTORY samples
+    std::array<double, HISTORY> samples{};
+    size_t count{0};
+    size_t next{0};
+  };
+
+  // lets _history be searched with a const char * without building a
+  // std::string every frame
+  struct NameHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view name) const {
+      return std::hash<std::string_view>{}(name);
+    }
+  };
+
+  void collect(FrameQueries &frame);
+
+  VkDevice _device;
+  bool _enabled{true};
+  // nanoseconds per timestamp tick
+  double _timestampPeriod{1.};
+  // mask of the valid timestamp bits, the rest is garbage
+  uint64_t _timestampMask{~0ULL};
+
+  std::vector<FrameQueries> _frames;
+  FrameQueries *_current{};
+  uint32_t _depth{0};
+
+  bool _pipelineStatistics{false};
+  uint64_t _fragmentInvocations{0};
+  uint64_t _statisticsFrames{0};
+
+  std::unordered_map<std::string, History, NameHash, std::equal_to<>>
+      _history;
+  std::vector<std::string> _order;
+  std::vector<uint64_t> _results;
+  // every scope of the most recently read back frame
+  std::vector<Sample> _latestFrame;
+};
+
+// begins a gpu profiler scope and ends it when going out of scope
+class GpuScope {
+ public:
+  GpuScope(GpuProfiler &profiler, VkCommandBuffer cmd, const char *name)
+      : _profiler{profiler}, _cmd{cmd}, _scope{profiler.begin(cmd, name)} {}
+  GpuScope(const GpuScope &) = delete;
+  GpuScope(GpuScope &&) = delete;
+  GpuScope &operator=(const GpuScope &) = delete;
+  GpuScope &operator=(GpuScope &&) = delete;
+  ~GpuScope() { _profiler.end(_cmd, _scope); }
+
+ private:
+  GpuProfiler &_profiler;
+  VkCommandBuffer _cmd;
+  uint32_t _scope;
+};
@@ -3,10 +3,12 @@
 #include <fmt/format.h>
 #include <spdlog/spdlog.h>
 
-void vk_check(vk::Result err, std::source_location loc) noexcept {
-  if (err != vk::Result::eSuccess) {
+#include <vulkan/vulkan.hpp>
+
+void vk_check(VkResult err, std::source_location loc) noexcept {
+  if (err != VK_SUCCESS) {
     spdlog::error("Vulkan error: {} {}: {}\n", loc.file_name(), loc.line(),
-                  vk::to_string(err));
+                  vk::to_string(static_cast<vk::Result>(err)));
     std::terminate();
   }
 }
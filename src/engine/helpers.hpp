@@ -1,12 +1,12 @@
 #pragma once
 
 #include <SDL_error.h>
+#include <volk.h>
 
 #include <source_location>
-#include <vulkan/vulkan.hpp>
 
-void vk_check(vk::Result err, std::source_location loc =
-                                  std::source_location::current()) noexcept;
+void vk_check(VkResult err, std::source_location loc =
+                                std::source_location::current()) noexcept;
 
 void sdl_check(bool p_success, std::source_location loc =
                                    std::source_location::current()) noexcept;
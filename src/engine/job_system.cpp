@@ -0,0 +1,280 @@
+#include "job_system.hpp"
+
+#include <stdexcept>
+
+namespace {
+
+// the system the calling thread is a worker of, and its index there. every
+// worker owns its deque and job pool, so a thread of another system or one
+// that was never a worker must not use them
+thread_local const JobSystem* tls_system = nullptr;
+thread_local uint32_t tls_workerIndex = 0;
+
+}  // namespace
+
+bool JobDeque::push(Job* job) {
+  int64_t bottom = _bottom.load(std::memory_order_relaxed);
+  int64_t top = _top.load(std::memory_order_acquire);
+
+  if (bottom - top >= CAPACITY) {
+    return false;
+  }
+
+  _jobs[bottom & MASK].store(job, std::memory_order_relaxed);
+  // the job has to be visible before thieves can see the new bottom
+  _bottom.store(bottom + 1, std::memory_order_release);
+  return true;
+}
+
+Job* JobDeque::pop() {
+  int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+  _bottom.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t top = _top.load(std::memory_order_relaxed);
+
+  if (top > bottom) {
+    // empty
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  Job* job = _jobs[bottom & MASK].load(std::memory_order_relaxed);
+  if (top == bottom) {
+    // last job, race the thieves for it
+    if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      job = nullptr;
+    }
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+Job* JobDeque::steal() {
+  int64_t top = _top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t bottom = _bottom.load(std::memory_order_acquire);
+
+  if (top >= bottom) {
+    return nullptr;
+  }
+
+  Job* job = _jobs[top & MASK].load(std::memory_order_relaxed);
+  if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    // lost to another thief or the owner
+    return nullptr;
+  }
+  return job;
+}
+
+JobSystem::JobSystem(uint32_t workerCount) {
+  workerCount = std::max(1U, workerCount);
+
+  _workers.reserve(workerCount);
+  for (uint32_t i = 0; i < workerCount; i++) {
+    _workers.push_back(std::make_unique<Worker>());
+  }
+
+  _previousSystem = std::exchange(tls_system, this);
+  _previousIndex = std::exchange(tls_workerIndex, 0U);
+
+  _threads.reserve(workerCount - 1);
+  for (uint32_t i = 1; i < workerCount; i++) {
+    _threads.emplace_back([this, i]() { worker_main(i); });
+  }
+}
+
+JobSystem::~JobSystem() {
+  _running.store(false, std::memory_order_release);
+  _generation.fetch_add(1, std::memory_order_release);
+  _generation.notify_all();
+
+  _threads.clear();
+
+  if (tls_system == this) {
+    tls_system = _previousSystem;
+    tls_workerIndex = _previousIndex;
+  }
+}
+
+void JobSystem::wait(const JobCounter& counter) {
+  while (!counter.done()) {
+    if (Job* job = next_job()) {
+      execute(job);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+uint32_t JobSystem::worker_index() const {
+  if (tls_system != this) {
+    throw std::runtime_error("job system used from a thread that isn't one "
+                             "of its workers");
+  }
+  return tls_workerIndex;
+}
+
+Job* JobSystem::allocate_job() {
+  Worker& worker = *_workers[worker_index()];
+  Job* job = &worker.pool[worker.nextJob];
+  worker.nextJob = (worker.nextJob + 1) % JobDeque::CAPACITY;
+
+  // the ring wrapped around onto a job that hasn't run yet, help out until
+  // it has
+  while (job->inFlight.load(std::memory_order_acquire)) {
+    if (Job* other = next_job()) {
+      execute(other);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  job->inFlight.store(true, std::memory_order_relaxed);
+  return job;
+}
+
+void JobSystem::add_job(JobCounter& counter) {
+  uint32_t value = counter._value.load(std::memory_order_relaxed);
+  while (true) {
+    if ((value & JobCounter::LOCKED) != 0) {
+      // the last job may be about to store zero over this increment
+      std::this_thread::yield();
+      value = counter._value.load(std::memory_order_relaxed);
+      continue;
+    }
+    if (counter._value.compare_exchange_weak(value, value + 1,
+                                             std::memory_order_relaxed)) {
+      return;
+    }
+  }
+}
+
+void JobSystem::submit(Job* job) {
+  if (!_workers[worker_index()]->deque.push(job)) {
+    // deque is full, no point queueing more. run it right here
+    execute(job);
+    return;
+  }
+
+  _generation.fetch_add(1, std::memory_order_release);
+  _generation.notify_one();
+}
+
+void JobSystem::schedule(Job* job, JobCounter* dependency) {
+  if (dependency == nullptr) {
+    submit(job);
+    return;
+  }
+
+  uint32_t value = dependency->_value.load(std::memory_order_acquire);
+  while (true) {
+    if (value == 0) {
+      submit(job);
+      return;
+    }
+    if ((value & JobCounter::LOCKED) != 0) {
+      std::this_thread::yield();
+      value = dependency->_value.load(std::memory_order_acquire);
+      continue;
+    }
+    if (dependency->_value.compare_exchange_weak(
+            value, value | JobCounter::LOCKED, std::memory_order_acquire)) {
+      break;
+    }
+  }
+
+  job->nextContinuation = dependency->_continuations;
+  dependency->_continuations = job;
+
+  dependency->_value.fetch_and(~JobCounter::LOCKED, std::memory_order_release);
+}
+
+Job* JobSystem::next_job() {
+  const uint32_t self = worker_index();
+
+  if (Job* job = _workers[self]->deque.pop()) {
+    return job;
+  }
+
+  const auto count = static_cast<uint32_t>(_workers.size());
+  for (uint32_t i = 1; i < count; i++) {
+    if (Job* job = _workers[(self + i) % count]->deque.steal()) {
+      _steals.fetch_add(1, std::memory_order_relaxed);
+      return job;
+    }
+  }
+
+  return nullptr;
+}
+
+void JobSystem::execute(Job* job) {
+  JobCounter* counter = job->counter;
+
+  job->function(job->storage.data());
+  job->inFlight.store(false, std::memory_order_release);
+
+  finish(*counter);
+}
+
+void JobSystem::finish(JobCounter& counter) {
+  uint32_t value = counter._value.load(std::memory_order_relaxed);
+  while (true) {
+    if ((value & ~JobCounter::LOCKED) > 1) {
+      // not the last job, nothing else to do
+      if (counter._value.compare_exchange_weak(value, value - 1,
+                                               std::memory_order_acq_rel)) {
+        return;
+      }
+      continue;
+    }
+    if ((value & JobCounter::LOCKED) != 0) {
+      // someone is adding a continuation, let them finish first
+      std::this_thread::yield();
+      value = counter._value.load(std::memory_order_relaxed);
+      continue;
+    }
+    if (counter._value.compare_exchange_weak(
+            value, 1 | JobCounter::LOCKED, std::memory_order_acq_rel)) {
+      break;
+    }
+  }
+
+  Job* continuation = std::exchange(counter._continuations, nullptr);
+
+  // unlocks and drops the count to zero at once. add_job can't have raised
+  // the count while it was locked. the counter must not be touched after this
+  counter._value.store(0, std::memory_order_release);
+
+  while (continuation != nullptr) {
+    Job* next = continuation->nextContinuation;
+    submit(continuation);
+    continuation = next;
+  }
+}
+
+void JobSystem::worker_main(uint32_t index) {
+  tls_system = this;
+  tls_workerIndex = index;
+
+  while (_running.load(std::memory_order_acquire)) {
+    if (Job* job = next_job()) {
+      execute(job);
+      continue;
+    }
+
+    // read the generation before looking again, so a submit between the
+    // check and the wait still wakes us up
+    uint32_t generation = _generation.load(std::memory_order_acquire);
+    if (Job* job = next_job()) {
+      execute(job);
+      continue;
+    }
+
+    if (!_running.load(std::memory_order_acquire)) {
+      break;
+    }
+    _generation.wait(generation, std::memory_order_acquire);
+  }
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct Job;
+
+// avoids false sharing between the deque ends and between workers
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// counts unfinished jobs. jobs can be scheduled to start once a counter
+// reaches zero, which is how dependencies are expressed
+class JobCounter {
+ public:
+  JobCounter() = default;
+  JobCounter(const JobCounter &) = delete;
+  JobCounter(JobCounter &&) = delete;
+  JobCounter &operator=(const JobCounter &) = delete;
+  JobCounter &operator=(JobCounter &&) = delete;
+  ~JobCounter() = default;
+
+  [[nodiscard]] bool done() const {
+    return _value.load(std::memory_order_acquire) == 0;
+  }
+
+ private:
+  friend class JobSystem;
+
+  // set while _continuations is being modified. it lives in the same word as
+  // the count so that the last job can unlock and publish zero with a single
+  // store, after which the waiter is free to destroy the counter. no jobs can
+  // be added while it is set, the store would drop them
+  static constexpr uint32_t LOCKED = 1U << 31U;
+
+  std::atomic<uint32_t> _value{0};
+
+  // jobs waiting for this counter to reach zero
+  Job *_continuations{};
+};
+
+struct Job {
+  // big enough for a lambda capturing a few pointers
+  static constexpr size_t STORAGE_SIZE = 48;
+
+  void (*function)(void *storage);
+  JobCounter *counter;
+  Job *nextContinuation;
+  // set from allocation until the function returned, the slot can't be
+  // reused before that
+  std::atomic<bool> inFlight{false};
+  alignas(std::max_align_t) std::array<std::byte, STORAGE_SIZE> storage;
+};
+
+// fixed size Chase-Lev work stealing deque. the owning worker pushes and pops
+// at the bottom, every other worker steals from the top
+class JobDeque {
+ public:
+  static constexpr int64_t CAPACITY = 4096;
+
+  // owner only. returns false when full
+  bool push(Job *job);
+  // owner only
+  Job *pop();
+  // any thread
+  Job *steal();
+
+ private:
+  static constexpr int64_t MASK = CAPACITY - 1;
+  static_assert((CAPACITY & MASK) == 0, "capacity must be a power of two");
+
+  alignas(CACHE_LINE_SIZE) std::atomic<int64_t> _top{0};
+  alignas(CACHE_LINE_SIZE) std::atomic<int64_t> _bottom{0};
+  std::array<std::atomic<Job *>, CAPACITY> _jobs{};
+};
+
+// work stealing job scheduler. the thread that creates it becomes worker 0
+// and runs jobs whenever it waits on a counter. only worker threads may use
+// it, any other thread gets an exception.
+//
+// jobs are allocated from a per worker ring of JobDeque::CAPACITY entries.
+// when a worker has that many in flight, spawning more runs queued jobs until
+// a slot frees up.
+class JobSystem {
+ public:
+  explicit JobSystem(uint32_t workerCount = std::thread::hardware_concurrency());
+  JobSystem(const JobSystem &) = delete;
+  JobSystem(JobSystem &&) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+  JobSystem &operator=(JobSystem &&) = delete;
+  ~JobSystem();
+
+  // schedules f(). counter is incremented now and decremented once f returns.
+  // if dependency is given, f only starts after it reaches zero
+  template <typename F>
+  void run(JobCounter &counter, F &&function,
+           JobCounter *dependency = nullptr);
+
+  // runs other jobs until counter reaches zero
+  void wait(const JobCounter &counter);
+
+  // calls function(begin, end) over [0, count) in chunks of at most grain and
+  // waits for all of them
+  template <typename F>
+  void parallel_for(size_t count, size_t grain, F &&function);
+
+  [[nodiscard]] uint32_t worker_count() const {
+    return static_cast<uint32_t>(_workers.size());
+  }
+
+  // index of the calling worker thread, 0 for the creating thread
+  [[nodiscard]] uint32_t worker_index() const;
+
+  // number of jobs taken from another worker's deque so far
+  [[nodiscard]] uint64_t steal_count() const {
+    return _steals.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct alignas(CACHE_LINE_SIZE) Worker {
+    JobDeque deque;
+    std::array<Job, JobDeque::CAPACITY> pool;
+    uint32_t nextJob{0};
+  };
+
+  Job *allocate_job();
+  void add_job(JobCounter &counter);
+  void submit(Job *job);
+  void finish(JobCounter &counter);
+  void schedule(Job *job, JobCounter *dependency);
+  Job *next_job();
+  void execute(Job *job);
+  void worker_main(uint32_t index);
+
+  std::vector<std::unique_ptr<Worker>> _workers;
+  std::vector<std::jthread> _threads;
+
+  std::atomic<bool> _running{true};
+  // bumped on every submit so sleeping workers notice new work
+  std::atomic<uint32_t> _generation{0};
+  std::atomic<uint64_t> _steals{0};
+
+  // what the creating thread worked for before, restored on destruction
+  const JobSystem *_previousSystem{};
+  uint32_t _previousIndex{0};
+};
+
+template <typename F>
+void JobSystem::run(JobCounter &counter, F &&function,
+                    JobCounter *dependency) {
+  using Function = std::decay_t<F>;
+  static_assert(sizeof(Function) <= Job::STORAGE_SIZE,
+                "job captures too much, capture by reference instead");
+  static_assert(alignof(Function) <= alignof(std::max_align_t));
+
+  Job *job = allocate_job();
+  job->function = [](void *storage) {
+    auto *fn = std::launder(reinterpret_cast<Function *>(storage));
+    (*fn)();
+    fn->~Function();
+  };
+  job->counter = &counter;
+  job->nextContinuation = nullptr;
+  new (job->storage.data()) Function(std::forward<F>(function));
+
+  add_job(counter);
+
+  schedule(job, dependency);
+}
+
+template <typename F>
+void JobSystem::parallel_for(size_t count, size_t grain, F &&function) {
+  grain = std::max<size_t>(grain, 1);
+
+  JobCounter counter;
+  for (size_t begin = 0; begin < count; begin += grain) {
+    size_t end = std::min(begin + grain, count);
+    run(counter, [&function, begin, end]() { function(begin, end); });
+  }
+
+  wait(counter);
+}
@@ -0,0 +1,65 @@
+#include "linear_allocator.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+#include "helpers.hpp"
+
+namespace {
+
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+LinearAllocator::LinearAllocator(VkDevice device, VmaAllocator allocator,
+                                 VkDeviceSize capacity, VkDeviceSize alignment,
+                                 std::span<const uint32_t> queueFamilies)
+    : _allocator{allocator},
+      _buffer{static_cast<size_t>(capacity),
+              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                  VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                  VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+              VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::Transient,
+              queueFamilies},
+      _capacity{capacity},
+      _alignment{std::max<VkDeviceSize>(alignment, 16)} {
+  const VkBufferDeviceAddressInfo info{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+      .buffer = _buffer._buffer};
+  _address = vkGetBufferDeviceAddress(device, &info);
+}
+
+TransientAllocation LinearAllocator::allocate(VkDeviceSize size,
+                                              VkDeviceSize alignment) {
+  const VkDeviceSize offset = align_up(_used, std::max(alignment, _alignment));
+  if (offset + size > _capacity) {
+    throw std::runtime_error(fmt::format(
+        "transient allocator out of room: {} bytes requested, {} of {} used",
+        size, _used, _capacity));
+  }
+
+  _used = offset + size;
+  _highWater = std::max(_highWater, _used);
+
+  return {
+      .data = static_cast<std::byte *>(_buffer._info.pMappedData) + offset,
+      .buffer = _buffer._buffer,
+      .offset = offset,
+      .address = _address + offset,
+  };
+}
+
+void LinearAllocator::flush() {
+  if (_used != 0) {
+    vk_check(vmaFlushAllocation(_allocator, _buffer._allocation, 0, _used));
+  }
+}
+
+void LinearAllocator::reset() { _used = 0; }
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vk_mem_alloc.h>
+#include <volk.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+
+#include "struct.hpp"
+
+// a slice of a LinearAllocator's buffer
+struct TransientAllocation {
+  // persistently mapped, written by the cpu
+  void *data;
+  VkBuffer buffer;
+  // for dynamic uniform or storage buffer offsets into buffer
+  VkDeviceSize offset;
+  VkDeviceAddress address;
+};
+
+// hands out slices of one persistently mapped buffer for data the cpu writes
+// and the gpu reads within a frame, uniforms, per draw data and the like.
+// every frame in flight has its own, allocating is bumping an offset and
+// everything is freed at once by reset. it never grows, running out of room
+// throws. not thread safe, allocate from the thread recording the frame
+class LinearAllocator {
+ public:
+  // alignment applies to every allocation unless a larger one is asked for,
+  // at least the device's min uniform and storage buffer offset alignment.
+  // the buffer is shared by queueFamilies, every queue reading from it
+  LinearAllocator(VkDevice device, VmaAllocator allocator,
+                  VkDeviceSize capacity, VkDeviceSize alignment,
+                  std::span<const uint32_t> queueFamilies);
+
+  TransientAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+
+  // copies data into a new allocation
+  template <typename T>
+  TransientAllocation push(std::span<const T> data) {
+    TransientAllocation allocation = allocate(data.size_bytes(), alignof(T));
+    std::copy(data.begin(), data.end(), static_cast<T *>(allocation.data));
+    return allocation;
+  }
+
+  // makes what was written since the last reset visible to the gpu, before
+  // submitting the frame
+  void flush();
+
+  // frees everything at once. the gpu has to be done with the frame that
+  // last used the allocator, i.e. its timeline value retired
+  void reset();
+
+  [[nodiscard]] VkBuffer buffer() const { return _buffer._buffer; }
+  [[nodiscard]] VkDeviceSize capacity() const { return _capacity; }
+  [[nodiscard]] VkDeviceSize used() const { return _used; }
+  // most ever used between two resets
+  [[nodiscard]] VkDeviceSize high_water() const { return _highWater; }
+
+ private:
+  VmaAllocator _allocator;
+  AllocatedBuffer _buffer;
+  VkDeviceSize _capacity;
+  VkDeviceSize _alignment;
+  VkDeviceAddress _address;
+  VkDeviceSize _used{0};
+  VkDeviceSize _highWater{0};
+};
@@ -8,10 +8,12 @@
 #include <fastgltf/tools.hpp>
 #include <glm/gtx/quaternion.hpp>
 
+#include "cpu_profiler.hpp"
 #include "engine.hpp"
 
 std::optional<std::vector<std::shared_ptr<MeshAsset>>> loadGltfMeshes(
     std::filesystem::path const& filePath) {
+  PROFILE_SCOPE("loadGltfMeshes");
   spdlog::info("Loading GLTF: {}", filePath.string());
 
   auto expectedData = fastgltf::GltfDataBuffer::FromPath(filePath);
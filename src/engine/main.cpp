@@ -1,7 +1,80 @@
+#include <CLI/CLI.hpp>
+#include <map>
+#include <string>
+
 #include "engine.hpp"
 
-int main() {
-  Engine &engine = get_engine();
+int main(int argc, char** argv) {
+  EngineConfig config{};
+
+  const std::map<std::string, VkPresentModeKHR> presentModes{
+      {"fifo", VK_PRESENT_MODE_FIFO_KHR},
+      {"fifo_relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR},
+      {"mailbox", VK_PRESENT_MODE_MAILBOX_KHR},
+      {"immediate", VK_PRESENT_MODE_IMMEDIATE_KHR},
+  };
+
+  CLI::App app{"vulkan engine"};
+  app.add_option("--present-mode", config.presentMode,
+                 "preferred present mode, falls back to what is supported")
+      ->transform(CLI::CheckedTransformer(presentModes, CLI::ignore_case));
+  app.add_option("--swapchain-images", config.swapchainImageCount,
+                 "minimum number of swapchain images")
+      ->check(CLI::Range(2U, 8U));
+  app.add_option("--frames-in-flight", config.framesInFlight,
+                 "frames recorded ahead of the gpu, trades latency for "
+                 "throughput")
+      ->check(CLI::Range(1U, MAX_FRAMES_IN_FLIGHT));
+  app.add_option("--transient-mb", config.transientMb,
+                 "MiB per frame for per draw and other transient gpu data")
+      ->check(CLI::PositiveNumber);
+  app.add_flag("--uncapped", config.uncapped,
+               "don't wait for vsync and report frames per second");
+  app.add_flag("--headless", config.headless,
+               "render offscreen without a window, works on lavapipe");
+  app.add_option("--frames", config.headlessFrames,
+                 "number of frames to render in headless mode")
+      ->check(CLI::PositiveNumber);
+  app.add_flag("--blit-present", config.blitPresent,
+               "blit the frame to the swapchain instead of compositing it");
+  app.add_flag("--uber-shaders", config.uberShaders,
+               "draw with the runtime branching material pipelines");
+  app.add_flag("--depth-prepass", config.depthPrepass,
+               "lay down depth before shading expensive materials");
+  app.add_flag("--occlusion-culling", config.occlusionCulling,
+               "skip objects hidden behind others, culled on the gpu");
+  app.add_flag("--async-compute", config.asyncCompute,
+               "cull and build the hi-z pyramid on a separate compute queue");
+  app.add_flag("--loader-dispatch", config.loaderDispatch,
+               "call device functions through the vulkan loader");
+  app.add_flag("--vertex-pulling", config.vertexPulling,
+               "read vertices through buffer device addresses in the shader");
+  app.add_option("--draw-copies", config.drawCopies,
+                 "draw the scene this many times, for stress testing")
+      ->check(CLI::PositiveNumber);
+  app.add_option("--trace", config.tracePath,
+                 "chrome trace file written on F12 or after --trace-frames");
+  app.add_option("--trace-frames", config.traceFrames,
+                 "write the trace after this many frames")
+      ->needs("--trace");
+  app.add_option("--memory-report", config.memoryReportPath,
+                 "json gpu memory report written on F11");
+  app.add_flag("--descriptor-buffer", config.descriptorBuffer,
+               "bind textures through VK_EXT_descriptor_buffer if supported");
+  app.add_option("--asset-dir", config.assetDir,
+                 "directory the models and textures are loaded from");
+  app.add_option("--gpu-budget", config.gpuBudgetMs,
+                 "gpu frame time in ms to hold by lowering the resolution")
+      ->check(CLI::PositiveNumber);
+
+  CLI11_PARSE(app, argc, argv);
+
+  // benchmarking makes no sense when locked to the display
+  if (config.uncapped && app.count("--present-mode") == 0) {
+    config.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+  }
+
+  Engine& engine = get_engine(config);
 
   engine.run();
 
@@ -0,0 +1,106 @@
+#include "material.hpp"
+
+#include <array>
+#include <cstddef>
+#include <ranges>
+
+#include "engine.hpp"
+#include "vulkan/pipelinebuilder.hpp"
+
+namespace {
+
+// layout of the specialization constants in colored_triangle.frag
+struct SpecializationData {
+  uint32_t features;
+  VkBool32 uber;
+};
+
+constexpr std::array<VkSpecializationMapEntry, 2> SPECIALIZATION_ENTRIES{
+    VkSpecializationMapEntry{
+        .constantID = 0,
+        .offset = offsetof(SpecializationData, features),
+        .size = sizeof(uint32_t),
+    },
+    VkSpecializationMapEntry{
+        .constantID = 1,
+        .offset = offsetof(SpecializationData, uber),
+        .size = sizeof(VkBool32),
+    },
+};
+
+}  // namespace
+
+MaterialPipelines::~MaterialPipelines() {
+  Engine& engine = Engine::instance();
+
+  for (const Variants& variants : _pipelines | std::views::values) {
+    vkDestroyPipeline(engine._device, variants.opaque, nullptr);
+    vkDestroyPipeline(engine._device, variants.afterPrepass, nullptr);
+  }
+  vkDestroyPipeline(engine._device, _uber.opaque, nullptr);
+  vkDestroyPipeline(engine._device, _uber.afterPrepass, nullptr);
+  vkDestroyPipeline(engine._device, _depthOnly, nullptr);
+}
+
+void MaterialPipelines::build(PipelineBuilder& builder,
+                              std::span<const MaterialFeatures> usedFeatures) {
+  for (MaterialFeatures features : usedFeatures) {
+    if (_pipelines.contains(features)) {
+      continue;
+    }
+    _pipelines[features] = build_variants(builder, features, false);
+  }
+
+  if (_uber.opaque == VK_NULL_HANDLE) {
+    _uber = build_variants(builder, 0, true);
+  }
+
+  if (_depthOnly == VK_NULL_HANDLE) {
+    builder.set_depth_only();
+    builder.enable_depthtest(true, VK_COMPARE_OP_GREATER_OR_EQUAL);
+    _depthOnly = builder.build_pipeline(Engine::instance()._device);
+  }
+}
+
+VkPipeline MaterialPipelines::get(MaterialFeatures features,
+                                  bool afterPrepass) const {
+  const Variants& variants = _pipelines.at(features);
+  return afterPrepass ? variants.afterPrepass : variants.opaque;
+}
+
+MaterialPipelines::Variants MaterialPipelines::build_variants(
+    PipelineBuilder& builder, MaterialFeatures features, bool uber) {
+  Variants variants{};
+
+  // reverse-z, nearer is greater
+  builder.enable_depthtest(true, VK_COMPARE_OP_GREATER_OR_EQUAL);
+  variants.opaque = build_variant(builder, features, uber);
+
+  // the prepass wrote the depth of the nearest surface, only it passes. the
+  // vertex shader's position is invariant so both passes get the same depth
+  builder.enable_depthtest(false, VK_COMPARE_OP_EQUAL);
+  variants.afterPrepass = build_variant(builder, features, uber);
+
+  return variants;
+}
+
+VkPipeline MaterialPipelines::build_variant(PipelineBuilder& builder,
+                                            MaterialFeatures features,
+                                            bool uber) {
+  SpecializationData data{
+      .features = features,
+      .uber = uber ? VK_TRUE : VK_FALSE,
+  };
+
+  VkSpecializationInfo info{};
+  info.mapEntryCount = static_cast<uint32_t>(SPECIALIZATION_ENTRIES.size());
+  info.pMapEntries = SPECIALIZATION_ENTRIES.data();
+  info.dataSize = sizeof(data);
+  info.pData = &data;
+
+  builder.set_specialization_info(&info);
+  VkPipeline pipeline = builder.build_pipeline(Engine::instance()._device);
+  builder.set_specialization_info(nullptr);
+
+  return pipeline;
+}
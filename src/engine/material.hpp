@@ -0,0 +1,72 @@
+#pragma once
+
+#include <volk.h>
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+
+class PipelineBuilder;
+
+// features a material can ask for. they reach the shaders as a specialization
+// constant, keep in sync with colored_triangle.frag
+enum MaterialFeatureBits : uint32_t {
+  MATERIAL_FEATURE_TEXTURED = 1U << 0U,
+  MATERIAL_FEATURE_VERTEX_COLOR = 1U << 1U,
+};
+using MaterialFeatures = uint32_t;
+
+struct Material {
+  MaterialFeatures features{};
+  // bindless table slots, used when MATERIAL_FEATURE_TEXTURED is set
+  uint32_t textureIndex{};
+  uint32_t samplerIndex{};
+  // expensive to shade. with the depth prepass on its depth is laid down
+  // first and the color pass only shades the fragments that end up visible
+  bool depthPrepass{false};
+};
+
+// one pipeline per used feature combination, plus an uber pipeline that
+// branches on the features at runtime for comparison. each comes in two
+// depth variants, one testing and writing depth and one only shading where
+// the depth prepass left exactly its depth. the depth prepass itself uses a
+// single depth only pipeline
+class MaterialPipelines {
+ public:
+  MaterialPipelines() = default;
+  MaterialPipelines(const MaterialPipelines &) = delete;
+  MaterialPipelines(MaterialPipelines &&) = delete;
+  MaterialPipelines &operator=(const MaterialPipelines &) = delete;
+  MaterialPipelines &operator=(MaterialPipelines &&) = delete;
+  ~MaterialPipelines();
+
+  // builder has to be fully configured except for specialization info and
+  // depth testing. it is left set up for depth only pipelines
+  void build(PipelineBuilder &builder,
+             std::span<const MaterialFeatures> usedFeatures);
+
+  // afterPrepass picks the variant for materials drawn in the depth prepass
+  [[nodiscard]] VkPipeline get(MaterialFeatures features,
+                               bool afterPrepass) const;
+
+  [[nodiscard]] VkPipeline uber(bool afterPrepass) const {
+    return afterPrepass ? _uber.afterPrepass : _uber.opaque;
+  }
+
+  [[nodiscard]] VkPipeline depth_only() const { return _depthOnly; }
+
+ private:
+  struct Variants {
+    VkPipeline opaque{};
+    VkPipeline afterPrepass{};
+  };
+
+  static Variants build_variants(PipelineBuilder &builder,
+                                 MaterialFeatures features, bool uber);
+  static VkPipeline build_variant(PipelineBuilder &builder,
+                                  MaterialFeatures features, bool uber);
+
+  std::unordered_map<MaterialFeatures, Variants> _pipelines;
+  Variants _uber{};
+  VkPipeline _depthOnly{};
+};
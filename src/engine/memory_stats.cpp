@@ -0,0 +1,208 @@
+#include "memory_stats.hpp"
+
+#include <fmt/format.h>
+
+#include <cstdio>
+#include <string>
+
+namespace {
+
+constexpr double MIB = 1024. * 1024.;
+
+BudgetState budget_state(const HeapBudget &heap) {
+  if (heap.budget == 0) {
+    return BudgetState::Ok;
+  }
+  if (heap.usage > heap.budget) {
+    return BudgetState::Exceeded;
+  }
+  if (static_cast<double>(heap.usage) >
+      static_cast<double>(heap.budget) * MemoryStats::WARNING_RATIO) {
+    return BudgetState::Warning;
+  }
+  return BudgetState::Ok;
+}
+
+}  // namespace
+
+std::string_view to_string(BudgetState state) {
+  switch (state) {
+    case BudgetState::Ok:
+      return "ok";
+    case BudgetState::Warning:
+      return "warning";
+    case BudgetState::Exceeded:
+      return "exceeded";
+  }
+  return "unknown";
+}
+
+std::string_view to_string(MemoryCategory category) {
+  switch (category) {
+    case MemoryCategory::Mesh:
+      return "mesh";
+    case MemoryCategory::Texture:
+      return "texture";
+    case MemoryCategory::Staging:
+      return "staging";
+    case MemoryCategory::RenderTarget:
+      return "render target";
+    case MemoryCategory::Transient:
+      return "transient";
+    case MemoryCategory::Other:
+    case MemoryCategory::Count:
+      break;
+  }
+  return "other";
+}
+
+MemoryStats::MemoryStats(VmaAllocator allocator) : _allocator{allocator} {
+  const VkPhysicalDeviceMemoryProperties *properties{};
+  vmaGetMemoryProperties(_allocator, &properties);
+
+  _heapCount = properties->memoryHeapCount;
+  for (uint32_t i = 0; i < _heapCount; i++) {
+    _deviceLocal[i] =
+        (properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) !=
+        0;
+  }
+}
+
+void *MemoryStats::user_data(MemoryCategory category) {
+  return reinterpret_cast<void *>(static_cast<uintptr_t>(category));
+}
+
+MemoryCategory MemoryStats::category_of(const VmaAllocationInfo &info) {
+  const auto value = reinterpret_cast<uintptr_t>(info.pUserData);
+  if (value >= static_cast<uintptr_t>(MemoryCategory::Count)) {
+    return MemoryCategory::Other;
+  }
+  return static_cast<MemoryCategory>(value);
+}
+
+void MemoryStats::track(VmaAllocation allocation) {
+  VmaAllocationInfo info{};
+  vmaGetAllocationInfo(_allocator, allocation, &info);
+
+  const MemoryCategory category = category_of(info);
+  // shows up in the detailed json
+  vmaSetAllocationName(_allocator, allocation, to_string(category).data());
+
+  _categoryBytes[static_cast<size_t>(category)].fetch_add(
+      info.size, std::memory_order_relaxed);
+}
+
+void MemoryStats::untrack(VmaAllocation allocation) {
+  VmaAllocationInfo info{};
+  vmaGetAllocationInfo(_allocator, allocation, &info);
+
+  _categoryBytes[static_cast<size_t>(category_of(info))].fetch_sub(
+      info.size, std::memory_order_relaxed);
+}
+
+void MemoryStats::update(uint32_t frameIndex) {
+  vmaSetCurrentFrameIndex(_allocator, frameIndex);
+
+  for (const HeapBudget &heap : heap_budgets()) {
+    const BudgetState state = budget_state(heap);
+    BudgetState &previous = _budgetStates[heap.heap];
+    if (state == previous) {
+      continue;
+    }
+
+    const BudgetEvent event{
+        .heap = heap,
+        .previous = previous,
+        .state = state,
+    };
+    previous = state;
+
+    for (const BudgetListener &listener : _listeners) {
+      listener(event);
+    }
+  }
+}
+
+void MemoryStats::add_budget_listener(BudgetListener listener) {
+  _listeners.push_back(std::move(listener));
+}
+
+VkDeviceSize MemoryStats::category_bytes(MemoryCategory category) const {
+  return _categoryBytes[static_cast<size_t>(category)].load(
+      std::memory_order_relaxed);
+}
+
+std::vector<HeapBudget> MemoryStats::heap_budgets() const {
+  std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+  vmaGetHeapBudgets(_allocator, budgets.data());
+
+  std::vector<HeapBudget> result;
+  result.reserve(_heapCount);
+  for (uint32_t i = 0; i < _heapCount; i++) {
+    result.push_back(HeapBudget{
+        .heap = i,
+        .deviceLocal = _deviceLocal[i],
+        .usage = budgets[i].usage,
+        .budget = budgets[i].budget,
+    });
+  }
+  return result;
+}
+
+std::string MemoryStats::detailed_json() const {
+  std::string json = "{\"categories\":{";
+  for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); i++) {
+    json += fmt::format("{}\"{}\":{}", i == 0 ? "" : ",",
+                        to_string(static_cast<MemoryCategory>(i)),
+                        category_bytes(static_cast<MemoryCategory>(i)));
+  }
+
+  json += "},\"heaps\":[";
+  for (const HeapBudget &heap : heap_budgets()) {
+    json += fmt::format(
+        "{}{{\"heap\":{},\"device_local\":{},\"usage\":{},\"budget\":{}}}",
+        heap.heap == 0 ? "" : ",", heap.heap, heap.deviceLocal, heap.usage,
+        heap.budget);
+  }
+
+  // already json
+  char *vmaStats{};
+  vmaBuildStatsString(_allocator, &vmaStats, VK_TRUE);
+  json += fmt::format("],\"vma\":{}}}", vmaStats);
+  vmaFreeStatsString(_allocator, vmaStats);
+
+  return json;
+}
+
+bool MemoryStats::write_json(std::string_view path) const {
+  std::FILE *file = std::fopen(std::string(path).c_str(), "w");
+  if (file == nullptr) {
+    fmt::print("failed to open memory report {}\n", path);
+    return false;
+  }
+
+  const std::string json = detailed_json();
+  const bool ok = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+  std::fclose(file);
+
+  fmt::print("wrote memory report to {}\n", path);
+  return ok;
+}
+
+void MemoryStats::print() const {
+  fmt::print("  gpu memory:");
+  for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); i++) {
+    const auto category = static_cast<MemoryCategory>(i);
+    fmt::print(" {} {:.1f}", to_string(category),
+               static_cast<double>(category_bytes(category)) / MIB);
+  }
+  fmt::print(" MiB\n");
+
+  for (const HeapBudget &heap : heap_budgets()) {
+    fmt::print("  heap {}{}: {:.1f} / {:.1f} MiB, {}\n", heap.heap,
+               heap.deviceLocal ? " (device local)" : "",
+               static_cast<double>(heap.usage) / MIB,
+               static_cast<double>(heap.budget) / MIB,
+               to_string(budget_state(heap)));
+  }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vk_mem_alloc.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// what an allocation is used for. every buffer and image is tagged with one so
+// usage can be broken down
+enum class MemoryCategory : uint8_t {
+  Mesh,
+  Texture,
+  Staging,
+  RenderTarget,
+  // per frame LinearAllocator buffers
+  Transient,
+  Other,
+  Count,
+};
+
+std::string_view to_string(MemoryCategory category);
+
+struct HeapBudget {
+  uint32_t heap;
+  bool deviceLocal;
+  // bytes used by this process, from the memory budget extension when
+  // available, otherwise vma's own estimate
+  VkDeviceSize usage;
+  VkDeviceSize budget;
+};
+
+enum class BudgetState : uint8_t {
+  Ok,
+  // usage crossed WARNING_RATIO of the budget
+  Warning,
+  Exceeded,
+};
+
+std::string_view to_string(BudgetState state);
+
+// raised when a heap moves between budget states, in both directions
+struct BudgetEvent {
+  HeapBudget heap;
+  BudgetState previous;
+  BudgetState state;
+};
+
+// tracks gpu memory per category and heap and watches the heap budgets
+class MemoryStats {
+ public:
+  static constexpr double WARNING_RATIO = .9;
+
+  using BudgetListener = std::function<void(const BudgetEvent &)>;
+
+  explicit MemoryStats(VmaAllocator allocator);
+  MemoryStats(const MemoryStats &) = delete;
+  MemoryStats(MemoryStats &&) = delete;
+  MemoryStats &operator=(const MemoryStats &) = delete;
+  MemoryStats &operator=(MemoryStats &&) = delete;
+  ~MemoryStats() = default;
+
+  // to pass as VmaAllocationCreateInfo::pUserData, then call track once the
+  // allocation exists
+  static void *user_data(MemoryCategory category);
+
+  // names the allocation after its category and counts it
+  void track(VmaAllocation allocation);
+  // call before freeing an allocation that was tracked
+  void untrack(VmaAllocation allocation);
+
+  // once per frame. advances vma's frame index and raises budget events
+  void update(uint32_t frameIndex);
+
+  void add_budget_listener(BudgetListener listener);
+
+  [[nodiscard]] VkDeviceSize category_bytes(MemoryCategory category) const;
+  [[nodiscard]] std::vector<HeapBudget> heap_budgets() const;
+
+  // category totals plus vma's detailed map of every block and allocation
+  [[nodiscard]] std::string detailed_json() const;
+  bool write_json(std::string_view path) const;
+
+  void print() const;
+
+ private:
+  static MemoryCategory category_of(const VmaAllocationInfo &info);
+
+  VmaAllocator _allocator;
+  uint32_t _heapCount{0};
+  std::array<bool, VK_MAX_MEMORY_HEAPS> _deviceLocal{};
+
+  std::array<std::atomic<VkDeviceSize>,
+             static_cast<size_t>(MemoryCategory::Count)>
+      _categoryBytes{};
+
+  std::array<BudgetState, VK_MAX_MEMORY_HEAPS> _budgetStates{};
+  std::vector<BudgetListener> _listeners;
+};
@@ -7,6 +7,8 @@
 #include <cstddef>
 #include <expected>
 #include <glm/gtc/matrix_transform.hpp>
+#include <shaders/colored_triangle_frag.hpp>
+#include <shaders/colored_triangle_vert.hpp>
 
 #include "engine.hpp"
 #include "helpers.hpp"
@@ -25,8 +27,8 @@ void MonkeyHead::build_pipeline() {
   Engine& engine = Engine::instance();
 
   VkShaderModule triangleFragShader{};
-  if (!vkutil::load_shader_module("shaders/colored_triangle.frag.spv",
-                                  engine._device, &triangleFragShader)) {
+  if (!vkutil::load_shader_module(spirv::colored_triangle_frag, engine._device,
+                                  &triangleFragShader)) {
     throw std::runtime_error(
         "Error when building the triangle fragment shader module");
   }
@@ -34,8 +36,8 @@ void MonkeyHead::build_pipeline() {
   fmt::print("Triangle fragment shader succesfully loaded\n");
 
   VkShaderModule triangleVertexShader{};
-  if (!vkutil::load_shader_module("shaders/colored_triangle.vert.spv",
-                                  engine._device, &triangleVertexShader)) {
+  if (!vkutil::load_shader_module(spirv::colored_triangle_vert, engine._device,
+                                  &triangleVertexShader)) {
     throw std::runtime_error(
         "Error when building the triangle fragment shader module");
   }
@@ -63,14 +65,16 @@ void MonkeyHead::build_pipeline() {
   VkPushConstantRange pushConstant{};
   pushConstant.offset = 0;
   pushConstant.size = sizeof(PushConstants);
-  pushConstant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstant.stageFlags =
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
   VkPipelineLayoutCreateInfo pipeline_layout_info{};
   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipeline_layout_info.pNext = nullptr;
   pipeline_layout_info.pPushConstantRanges = &pushConstant;
   pipeline_layout_info.pushConstantRangeCount = 1;
-  pipeline_layout_info.pSetLayouts = &engine._descriptorSetLayout;
+  VkDescriptorSetLayout setLayout = engine._bindless->layout();
+  pipeline_layout_info.pSetLayouts = &setLayout;
   pipeline_layout_info.setLayoutCount = 1;
 
   vk_check(vkCreatePipelineLayout(engine._device, &pipeline_layout_info,
@@ -78,6 +82,7 @@ void MonkeyHead::build_pipeline() {
 
   PipelineBuilder pipelineBuilder;
   pipelineBuilder._pipelineLayout = _pipelineLayout;
+  pipelineBuilder.set_flags(engine._bindless->pipeline_flags());
   pipelineBuilder.set_shaders(triangleVertexShader, triangleFragShader);
   pipelineBuilder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
   pipelineBuilder.set_polygon_mode(VK_POLYGON_MODE_FILL);
@@ -85,13 +90,13 @@ void MonkeyHead::build_pipeline() {
                                 VK_FRONT_FACE_COUNTER_CLOCKWISE);
   pipelineBuilder.set_multisampling_none();
   pipelineBuilder.disable_blending();
-  pipelineBuilder.disable_depthtest();
+  pipelineBuilder.enable_depthtest(true, VK_COMPARE_OP_GREATER_OR_EQUAL);
   // pipelineBuilder.vertex_input(std::span(&bindingDescription, 1),
   //                              attributeDescriptions);
 
   // connect the image format we will draw into, from draw image
   pipelineBuilder.set_color_attachment_format(engine._drawImage.format);
-  pipelineBuilder.set_depth_format(VK_FORMAT_UNDEFINED);
+  pipelineBuilder.set_depth_format(DEPTH_FORMAT);
 
   _pipeline = pipelineBuilder.build_pipeline(engine._device);
 
@@ -101,14 +106,13 @@ void MonkeyHead::build_pipeline() {
 
 void MonkeyHead::draw(VkCommandBuffer cmd) {
   Engine& engine = Engine::instance();
-  FrameData& frame = engine.get_current_frame();
 
   vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline);
 
-  glm::mat4 Projection = glm::perspective(
+  glm::mat4 Projection = vkutil::perspective_reverse_z(
       glm::radians(45.0F),
-      float(engine._drawExtent.width) / float(engine._drawExtent.height), 0.1F,
-      10.0F);
+      float(engine._drawExtent.width) / float(engine._drawExtent.height),
+      0.1F);
   Projection[1][1] *= -1;
 
   glm::mat4 View =
@@ -124,8 +128,9 @@ void MonkeyHead::draw(VkCommandBuffer cmd) {
   pushConstants.mvp = mvp;
   pushConstants.vertexBuffer = _meshes[2]->meshBuffers.vertexBufferAddress;
 
-  vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
-                     sizeof(PushConstants), &pushConstants);
+  vkCmdPushConstants(cmd, _pipelineLayout,
+                     VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                     0, sizeof(PushConstants), &pushConstants);
 
   // std::array<VkBuffer, 1> vertexBuffers{_meshBuffers->vertexBuffer._buffer};
   // std::array<VkDeviceSize, 1> offsets{0};
@@ -134,8 +139,7 @@ void MonkeyHead::draw(VkCommandBuffer cmd) {
   vkCmdBindIndexBuffer(cmd, _meshes[2]->meshBuffers.indexBuffer._buffer, 0,
                        VK_INDEX_TYPE_UINT32);
 
-  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout,
-                          0, 1, &frame._descriptorSet, 0, nullptr);
+  engine._bindless->bind(cmd, _pipelineLayout);
 
   vkCmdDrawIndexed(cmd, _meshes[2]->surfaces[0].count, 1,
                    _meshes[2]->surfaces[0].startIndex, 0, 0);
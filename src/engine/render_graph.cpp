@@ -0,0 +1,1091 @@
+#include "render_graph.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+
+#include "cpu_profiler.hpp"
+#include "gpu_profiler.hpp"
+#include "helpers.hpp"
+#include "vulkan/ini.hpp"
+
+namespace {
+
+// of the stages accesses use, the ones queues without graphics have
+constexpr VkPipelineStageFlags2 COMPUTE_QUEUE_STAGES =
+    VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT |
+    VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+    VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+
+size_t index(PassQueue queue) { return static_cast<size_t>(queue); }
+
+PassQueue other(PassQueue queue) {
+  return queue == PassQueue::Graphics ? PassQueue::Compute
+                                      : PassQueue::Graphics;
+}
+
+VkImageAspectFlags aspect_of(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+      return VK_IMAGE_ASPECT_COLOR_BIT;
+  }
+}
+
+// every mip, imported images can have more than one
+VkImageSubresourceRange whole_image(VkFormat format) {
+  VkImageSubresourceRange range =
+      vkini::image_subresource_range(aspect_of(format));
+  range.levelCount = VK_REMAINING_MIP_LEVELS;
+  return range;
+}
+
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+RenderGraph::AccessInfo RenderGraph::access_info(ImageAccess access) {
+  switch (access) {
+    case ImageAccess::TransferSrc:
+      return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+              VK_ACCESS_2_TRANSFER_READ_BIT, 0,
+              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+              VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+    case ImageAccess::TransferDst:
+      return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, 0,
+              VK_ACCESS_2_TRANSFER_WRITE_BIT,
+              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+              VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+    case ImageAccess::ColorAttachment:
+      return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+              VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT,
+              VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+              VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+    case ImageAccess::ComputeRead:
+      return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+              VK_ACCESS_2_SHADER_STORAGE_READ_BIT, 0, VK_IMAGE_LAYOUT_GENERAL,
+              VK_IMAGE_USAGE_STORAGE_BIT};
+    case ImageAccess::ComputeWrite:
+      return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0,
+              VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+              VK_IMAGE_USAGE_STORAGE_BIT};
+    case ImageAccess::Sampled:
+      return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT |
+                  VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+              VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, 0,
+              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+              VK_IMAGE_USAGE_SAMPLED_BIT};
+    case ImageAccess::DepthAttachment:
+      return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                  VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+              VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+              VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+    case ImageAccess::DepthRead:
+      return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                  VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+              VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, 0,
+              VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+  }
+  return {};
+}
+
+RenderGraph::AccessInfo RenderGraph::access_info(BufferAccess access) {
+  switch (access) {
+    case BufferAccess::IndirectRead:
+      return {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+              VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, 0,
+              VK_IMAGE_LAYOUT_UNDEFINED, 0};
+    case BufferAccess::ComputeRead:
+      return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+              VK_ACCESS_2_SHADER_STORAGE_READ_BIT, 0,
+              VK_IMAGE_LAYOUT_UNDEFINED, 0};
+    case BufferAccess::ComputeWrite:
+      return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0,
+              VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+              0};
+    case BufferAccess::ComputeReadWrite:
+      return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+              VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+              VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+              0};
+  }
+  return {};
+}
+
+RenderGraph::AccessInfo RenderGraph::access_info(ImageAccess access,
+                                                 uint32_t batch) const {
+  AccessInfo info = access_info(access);
+  if (_batches[batch].queue == PassQueue::Compute) {
+    info.stages &= COMPUTE_QUEUE_STAGES;
+  }
+  return info;
+}
+
+RenderGraph::AccessInfo RenderGraph::access_info(BufferAccess access,
+                                                 uint32_t batch) const {
+  AccessInfo info = access_info(access);
+  if (_batches[batch].queue == PassQueue::Compute) {
+    info.stages &= COMPUTE_QUEUE_STAGES;
+  }
+  return info;
+}
+
+bool RenderGraph::TransientKey::operator==(const TransientKey &other) const {
+  return format == other.format && extent.width == other.extent.width &&
+         extent.height == other.extent.height && usage == other.usage &&
+         firstPass == other.firstPass && lastPass == other.lastPass;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::use(ImageHandle image,
+                                                        ImageAccess access) {
+  assert(_pass + 1 == _graph._passes.size() &&
+         "uses have to be declared before the next pass is added");
+  _graph._uses.push_back(Use{.image = image.index, .access = access});
+  _graph._passes[_pass].useCount++;
+  return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::use(BufferHandle buffer,
+                                                        BufferAccess access) {
+  assert(_pass + 1 == _graph._passes.size() &&
+         "uses have to be declared before the next pass is added");
+  _graph._bufferUses.push_back(
+      BufferUse{.buffer = buffer.index, .access = access});
+  _graph._passes[_pass].bufferUseCount++;
+  return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::async() {
+  if (_graph.has_async_compute()) {
+    _graph._passes[_pass].queue = PassQueue::Compute;
+  }
+  return *this;
+}
+
+RenderGraph::RenderGraph(VkDevice device, VmaAllocator allocator,
+                         MemoryStats &memoryStats, uint32_t frameCount,
+                         RenderQueue graphics,
+                         std::optional<RenderQueue> compute)
+    : _device{device},
+      _allocator{allocator},
+      _memoryStats{memoryStats},
+      _slots(frameCount) {
+  _queues[index(PassQueue::Graphics)] = graphics;
+  if (compute) {
+    _queues[index(PassQueue::Compute)] = *compute;
+
+    // batches only signal their timeline when there are two queues
+    VkSemaphoreTypeCreateInfo timelineInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0};
+    VkSemaphoreCreateInfo semaphoreInfo = vkini::semaphore_create_info();
+    semaphoreInfo.pNext = &timelineInfo;
+    for (VkSemaphore &timeline : _timelines) {
+      vk_check(vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &timeline));
+    }
+  }
+
+  // reset as a whole every time the slot comes around
+  for (FrameSlot &slot : _slots) {
+    for (size_t q = 0; q < PASS_QUEUES; q++) {
+      if (_queues[q].queue == VK_NULL_HANDLE) {
+        continue;
+      }
+      VkCommandPoolCreateInfo poolInfo = vkini::command_pool_create_info(
+          _queues[q].family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+      vk_check(
+          vkCreateCommandPool(_device, &poolInfo, nullptr, &slot.pools[q]));
+    }
+  }
+}
+
+RenderGraph::~RenderGraph() {
+  for (FrameSlot &slot : _slots) {
+    destroy_transients(slot);
+    for (VkCommandPool pool : slot.pools) {
+      vkDestroyCommandPool(_device, pool, nullptr);
+    }
+  }
+  for (VkSemaphore timeline : _timelines) {
+    vkDestroySemaphore(_device, timeline, nullptr);
+  }
+}
+
+void RenderGraph::reset(uint32_t frameSlot) {
+  _slot = frameSlot;
+  _images.clear();
+  _buffers.clear();
+  _uses.clear();
+  _bufferUses.clear();
+  _passes.clear();
+  _batches.clear();
+  _barriers.clear();
+  _bufferBarriers.clear();
+  _releases.clear();
+  _releaseBatches.clear();
+  _bufferReleases.clear();
+  _bufferReleaseBatches.clear();
+  _firstFinalBarrier = 0;
+  _firstFinalBufferBarrier = 0;
+
+  for (VkCommandPool pool : _slots.at(_slot).pools) {
+    if (pool != VK_NULL_HANDLE) {
+      vk_check(vkResetCommandPool(_device, pool, 0));
+    }
+  }
+}
+
+ImageHandle RenderGraph::import_image(VkImage image, VkImageView view,
+                                      VkFormat format, VkExtent2D extent,
+                                      VkImageLayout layout,
+                                      VkPipelineStageFlags2 lastStages,
+                                      VkImageLayout finalLayout) {
+  _images.push_back(Image{
+      .image = image,
+      .view = view,
+      .extent = extent,
+      .format = format,
+      .imported = true,
+      .finalLayout = finalLayout,
+      // whatever used it before may have written it
+      .state = {.queue = PassQueue::Graphics,
+                .batch = NONE,
+                .layout = layout,
+                .writeStages = lastStages,
+                .writeAccess = lastStages != 0 ? VK_ACCESS_2_MEMORY_WRITE_BIT
+                                               : VkAccessFlags2{0}},
+      .usage = 0,
+      .firstPass = NONE,
+      .lastPass = NONE,
+      .transient = NONE,
+  });
+  return ImageHandle{static_cast<uint32_t>(_images.size() - 1)};
+}
+
+BufferHandle RenderGraph::import_buffer(VkBuffer buffer,
+                                        VkPipelineStageFlags2 lastStages) {
+  _buffers.push_back(Buffer{
+      .buffer = buffer,
+      .state = {.queue = PassQueue::Graphics,
+                .batch = NONE,
+                .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .writeStages = lastStages,
+                .writeAccess = lastStages != 0 ? VK_ACCESS_2_MEMORY_WRITE_BIT
+                                               : VkAccessFlags2{0}},
+      .written = lastStages != 0,
+  });
+  return BufferHandle{static_cast<uint32_t>(_buffers.size() - 1)};
+}
+
+ImageHandle RenderGraph::create_image(VkFormat format, VkExtent2D extent) {
+  _images.push_back(Image{
+      .image = VK_NULL_HANDLE,
+      .view = VK_NULL_HANDLE,
+      .extent = extent,
+      .format = format,
+      .imported = false,
+      .finalLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      // taken by whichever queue uses it first
+      .state = {.queue = PassQueue::Graphics,
+                .batch = NONE,
+                .layout = VK_IMAGE_LAYOUT_UNDEFINED},
+      .usage = 0,
+      .firstPass = NONE,
+      .lastPass = NONE,
+      .transient = NONE,
+  });
+  return ImageHandle{static_cast<uint32_t>(_images.size() - 1)};
+}
+
+RenderGraph::PassBuilder RenderGraph::add_pass(const char *name,
+                                               RecordFunction &&record) {
+  _passes.push_back(Pass{
+      .name = name,
+      .record = std::move(record),
+      .queue = PassQueue::Graphics,
+      .batch = NONE,
+      .firstUse = static_cast<uint32_t>(_uses.size()),
+      .useCount = 0,
+      .firstBufferUse = static_cast<uint32_t>(_bufferUses.size()),
+      .bufferUseCount = 0,
+      .culled = false,
+      .firstBarrier = 0,
+      .barrierCount = 0,
+      .firstBufferBarrier = 0,
+      .bufferBarrierCount = 0,
+  });
+  return PassBuilder{*this, static_cast<uint32_t>(_passes.size() - 1)};
+}
+
+void RenderGraph::compile() {
+  PROFILE_SCOPE("RenderGraph::compile");
+
+  cull();
+  form_batches();
+
+  for (uint32_t p = 0; p < _passes.size(); p++) {
+    const Pass &pass = _passes[p];
+    if (pass.culled) {
+      continue;
+    }
+    for (uint32_t u = pass.firstUse; u < pass.firstUse + pass.useCount; u++) {
+      Image &image = _images[_uses[u].image];
+      image.usage |= access_info(_uses[u].access).usage;
+      image.firstPass = std::min(image.firstPass, p);
+      image.lastPass = p;
+    }
+  }
+
+  place_transients();
+
+  _stats.barrierBatches = 0;
+  _stats.queueTransfers = 0;
+  for (Pass &pass : _passes) {
+    if (pass.culled) {
+      continue;
+    }
+    pass.firstBarrier = static_cast<uint32_t>(_barriers.size());
+    pass.firstBufferBarrier = static_cast<uint32_t>(_bufferBarriers.size());
+    for (uint32_t u = pass.firstUse; u < pass.firstUse + pass.useCount; u++) {
+      add_barriers(_images[_uses[u].image], _uses[u].access, pass.batch);
+    }
+    for (uint32_t u = pass.firstBufferUse;
+         u < pass.firstBufferUse + pass.bufferUseCount; u++) {
+      add_barriers(_buffers[_bufferUses[u].buffer], _bufferUses[u].access,
+                   pass.batch);
+    }
+    pass.barrierCount =
+        static_cast<uint32_t>(_barriers.size()) - pass.firstBarrier;
+    pass.bufferBarrierCount = static_cast<uint32_t>(_bufferBarriers.size()) -
+                              pass.firstBufferBarrier;
+    _stats.barrierBatches +=
+        pass.barrierCount + pass.bufferBarrierCount != 0 ? 1 : 0;
+  }
+
+  _firstFinalBarrier = static_cast<uint32_t>(_barriers.size());
+  _firstFinalBufferBarrier = static_cast<uint32_t>(_bufferBarriers.size());
+  add_final_barriers();
+  const bool finalBarriers =
+      _barriers.size() != _firstFinalBarrier ||
+      _bufferBarriers.size() != _firstFinalBufferBarrier;
+  _stats.barrierBatches += finalBarriers ? 1 : 0;
+
+  // the frame is done once the last batch is, it waits for the other queue
+  Batch &last = _batches.back();
+  for (const Batch &batch : _batches) {
+    if (batch.queue != last.queue) {
+      last.waitValue = std::max(last.waitValue, batch.signalValue);
+      last.waitStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    }
+  }
+
+  _stats.passes = static_cast<uint32_t>(_passes.size());
+  _stats.batches = static_cast<uint32_t>(_batches.size());
+  _stats.imageBarriers =
+      static_cast<uint32_t>(_barriers.size() + _releases.size());
+  _stats.bufferBarriers =
+      static_cast<uint32_t>(_bufferBarriers.size() + _bufferReleases.size());
+}
+
+void RenderGraph::form_batches() {
+  const bool async = std::ranges::any_of(_passes, [](const Pass &pass) {
+    return !pass.culled && pass.queue == PassQueue::Compute;
+  });
+
+  auto add_batch = [this](PassQueue queue) {
+    _batches.push_back(Batch{.queue = queue,
+                             .waitValue = 0,
+                             .waitStages = 0,
+                             .signalValue = 0,
+                             .cmd = VK_NULL_HANDLE});
+  };
+
+  // with async compute the first batch only releases imported resources to
+  // compute, so compute passes don't wait for the graphics passes before
+  // them
+  if (async) {
+    add_batch(PassQueue::Graphics);
+  }
+  const size_t firstPassBatch = _batches.size();
+
+  _stats.asyncPasses = 0;
+  for (Pass &pass : _passes) {
+    if (pass.culled) {
+      continue;
+    }
+    if (_batches.size() == firstPassBatch ||
+        _batches.back().queue != pass.queue) {
+      add_batch(pass.queue);
+    }
+    pass.batch = static_cast<uint32_t>(_batches.size() - 1);
+    _stats.asyncPasses += pass.queue == PassQueue::Compute ? 1 : 0;
+  }
+
+  // the last batch takes resources back to graphics
+  if (_batches.empty() || _batches.back().queue != PassQueue::Graphics) {
+    add_batch(PassQueue::Graphics);
+  }
+
+  if (_batches.size() > 1) {
+    for (Batch &batch : _batches) {
+      batch.signalValue = ++_timelineValues[index(batch.queue)];
+    }
+  }
+}
+
+void RenderGraph::cull() {
+  // walking backwards, a pass is kept if it writes an image that a kept
+  // pass after it reads, or an output. what it reads is then needed too.
+  // buffers are all imported, so writing one always keeps a pass
+  _needed.assign(_images.size(), false);
+  for (size_t i = 0; i < _images.size(); i++) {
+    _needed[i] = _images[i].imported;
+  }
+
+  _stats.culledPasses = 0;
+  for (Pass &pass : std::ranges::reverse_view(_passes)) {
+    const auto uses = std::span(_uses).subspan(pass.firstUse, pass.useCount);
+    const auto bufferUses = std::span(_bufferUses)
+                                .subspan(pass.firstBufferUse,
+                                         pass.bufferUseCount);
+
+    const bool writesNeeded = std::ranges::any_of(uses, [this](const Use &use) {
+      return access_info(use.access).writeAccess != 0 && _needed[use.image];
+    });
+    const bool writesBuffer =
+        std::ranges::any_of(bufferUses, [](const BufferUse &use) {
+          return access_info(use.access).writeAccess != 0;
+        });
+    pass.culled = !writesNeeded && !writesBuffer;
+    if (pass.culled) {
+      _stats.culledPasses++;
+      continue;
+    }
+
+    for (const Use &use : uses) {
+      if (access_info(use.access).readAccess != 0) {
+        _needed[use.image] = true;
+      }
+    }
+  }
+}
+
+void RenderGraph::place_transients() {
+  _keys.clear();
+  for (Image &image : _images) {
+    if (image.imported || image.firstPass == NONE) {
+      continue;
+    }
+    image.transient = static_cast<uint32_t>(_keys.size());
+    _keys.push_back(TransientKey{
+        .format = image.format,
+        .extent = image.extent,
+        .usage = image.usage,
+        .firstPass = image.firstPass,
+        .lastPass = image.lastPass,
+    });
+  }
+
+  FrameSlot &slot = _slots.at(_slot);
+  if (slot.keys != _keys) {
+    PROFILE_SCOPE("RenderGraph::create_transients");
+    destroy_transients(slot);
+    slot.keys = _keys;
+    create_transients(slot);
+  }
+
+  for (Image &image : _images) {
+    if (image.transient != NONE) {
+      image.image = slot.images[image.transient].image;
+      image.view = slot.images[image.transient].view;
+    }
+  }
+
+  _stats.transientBytes = slot.bytes;
+  _stats.transientUnaliasedBytes = slot.unaliasedBytes;
+}
+
+void RenderGraph::create_transients(FrameSlot &slot) {
+  if (slot.keys.empty()) {
+    return;
+  }
+
+  VkMemoryRequirements requirements{
+      .size = 0, .alignment = 1, .memoryTypeBits = ~0U};
+  slot.images.resize(slot.keys.size());
+  slot.unaliasedBytes = 0;
+
+  for (size_t i = 0; i < slot.keys.size(); i++) {
+    const TransientKey &key = slot.keys[i];
+    VkImageCreateInfo imageInfo = vkini::image_create_info(
+        key.format, key.usage, {key.extent.width, key.extent.height, 1});
+
+    TransientImage &image = slot.images[i];
+    vk_check(vkCreateImage(_device, &imageInfo, nullptr, &image.image));
+
+    VkMemoryRequirements imageRequirements{};
+    vkGetImageMemoryRequirements(_device, image.image, &imageRequirements);
+    image.size = imageRequirements.size;
+    image.alignment = imageRequirements.alignment;
+
+    requirements.alignment =
+        std::max(requirements.alignment, imageRequirements.alignment);
+    requirements.memoryTypeBits &= imageRequirements.memoryTypeBits;
+    slot.unaliasedBytes += imageRequirements.size;
+  }
+
+  if (requirements.memoryTypeBits == 0) {
+    throw std::runtime_error("transient images have no memory type in common");
+  }
+
+  // largest first, each at the lowest offset that doesn't overlap an image
+  // placed before whose passes overlap its own
+  std::vector<uint32_t> order(slot.keys.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::sort(order, [&](uint32_t a, uint32_t b) {
+    return slot.images[a].size > slot.images[b].size;
+  });
+
+  auto lifetimes_overlap = [&](uint32_t a, uint32_t b) {
+    return slot.keys[a].firstPass <= slot.keys[b].lastPass &&
+           slot.keys[b].firstPass <= slot.keys[a].lastPass;
+  };
+
+  for (size_t placed = 0; placed < order.size(); placed++) {
+    TransientImage &image = slot.images[order[placed]];
+    image.offset = 0;
+
+    bool moved = true;
+    while (moved) {
+      moved = false;
+      for (size_t other = 0; other < placed; other++) {
+        const TransientImage &o = slot.images[order[other]];
+        if (lifetimes_overlap(order[placed], order[other]) &&
+            image.offset < o.offset + o.size &&
+            o.offset < image.offset + image.size) {
+          image.offset = align_up(o.offset + o.size, image.alignment);
+          moved = true;
+        }
+      }
+    }
+    requirements.size =
+        std::max(requirements.size, image.offset + image.size);
+  }
+  slot.bytes = requirements.size;
+
+  VmaAllocationCreateInfo allocInfo = {};
+  allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+  allocInfo.requiredFlags =
+      VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  allocInfo.pUserData = MemoryStats::user_data(MemoryCategory::RenderTarget);
+
+  vk_check(vmaAllocateMemory(_allocator, &requirements, &allocInfo,
+                             &slot.allocation, nullptr));
+  _memoryStats.track(slot.allocation);
+
+  for (size_t i = 0; i < slot.keys.size(); i++) {
+    TransientImage &image = slot.images[i];
+    vk_check(vmaBindImageMemory2(_allocator, slot.allocation, image.offset,
+                                 image.image, nullptr));
+
+    VkImageViewCreateInfo viewInfo = vkini::imageview_create_info(
+        slot.keys[i].format, image.image, aspect_of(slot.keys[i].format));
+    vk_check(vkCreateImageView(_device, &viewInfo, nullptr, &image.view));
+  }
+}
+
+void RenderGraph::destroy_transients(FrameSlot &slot) {
+  for (TransientImage &image : slot.images) {
+    vkDestroyImageView(_device, image.view, nullptr);
+    vkDestroyImage(_device, image.image, nullptr);
+  }
+  slot.images.clear();
+
+  if (slot.allocation != nullptr) {
+    _memoryStats.untrack(slot.allocation);
+    vmaFreeMemory(_allocator, slot.allocation);
+    slot.allocation = nullptr;
+  }
+  slot.bytes = 0;
+  slot.unaliasedBytes = 0;
+}
+
+void RenderGraph::wait_for_aliased(Image &image, const AccessInfo &info,
+                                   uint32_t batch) {
+  const FrameSlot &slot = _slots.at(_slot);
+  const TransientImage &placed = slot.images[image.transient];
+  Batch &waiting = _batches[batch];
+
+  for (const Image &other : _images) {
+    if (other.transient == NONE || other.lastPass >= image.firstPass) {
+      continue;
+    }
+    const TransientImage &o = slot.images[other.transient];
+    if (placed.offset < o.offset + o.size &&
+        o.offset < placed.offset + placed.size) {
+      if (other.state.queue != waiting.queue) {
+        waiting.waitValue = std::max(waiting.waitValue,
+                                     _batches[other.state.batch].signalValue);
+        waiting.waitStages |= info.stages;
+        continue;
+      }
+      image.state.writeStages |=
+          other.state.writeStages | other.state.readStages;
+      image.state.writeAccess |= other.state.writeAccess;
+    }
+  }
+}
+
+uint32_t RenderGraph::change_queue(SyncState &state, const AccessInfo &info,
+                                   uint32_t batch, bool keepContents) {
+  // before the graph it is on graphics, where the first batch releases it
+  const uint32_t releasing = state.batch != NONE ? state.batch : 0;
+
+  // the wait covers everything the other queue did with it so far
+  Batch &waiting = _batches[batch];
+  waiting.waitValue =
+      std::max(waiting.waitValue, _batches[releasing].signalValue);
+  waiting.waitStages |= info.stages;
+
+  if (!keepContents) {
+    return NONE;
+  }
+  _stats.queueTransfers++;
+  return releasing;
+}
+
+void RenderGraph::acquired(SyncState &state, const AccessInfo &info,
+                           PassQueue queue, uint32_t batch) {
+  // like in sync, the acquire counts as a write the access waited for
+  const bool writes = info.writeAccess != 0;
+  state.queue = queue;
+  state.batch = batch;
+  state.layout = info.layout;
+  state.writeStages = info.stages;
+  state.writeAccess = info.writeAccess;
+  state.readStages = writes ? 0 : info.stages;
+  state.visibleStages = writes ? 0 : info.stages;
+  state.visibleAccess = writes ? 0 : info.readAccess;
+}
+
+bool RenderGraph::sync(SyncState &state, const AccessInfo &info,
+                       VkPipelineStageFlags2 &srcStages,
+                       VkAccessFlags2 &srcAccess, VkImageLayout &oldLayout) {
+  const bool writes = info.writeAccess != 0;
+  const bool transition = state.layout != info.layout;
+
+  srcStages = 0;
+  if (writes || transition) {
+    // write after read has to wait for the readers too
+    srcStages = state.writeStages | state.readStages;
+  } else if ((info.stages & ~state.visibleStages) != 0 ||
+             (info.readAccess & ~state.visibleAccess) != 0) {
+    // read after write, unless an earlier read already waited for it
+    srcStages = state.writeStages;
+  }
+  srcAccess = state.writeAccess;
+  oldLayout = state.layout;
+
+  if (writes || transition) {
+    // a layout transition counts as a write the access waited for
+    state.layout = info.layout;
+    state.writeStages = info.stages;
+    state.writeAccess = info.writeAccess;
+    state.readStages = writes ? 0 : info.stages;
+    state.visibleStages = writes ? 0 : info.stages;
+    state.visibleAccess = writes ? 0 : info.readAccess;
+  } else {
+    state.readStages |= info.stages;
+    if (srcStages != 0) {
+      state.visibleStages |= info.stages;
+      state.visibleAccess |= info.readAccess;
+    }
+  }
+
+  return transition || srcStages != 0;
+}
+
+void RenderGraph::add_barriers(Image &image, ImageAccess access,
+                               uint32_t batch) {
+  const AccessInfo info = access_info(access, batch);
+  const PassQueue queue = _batches[batch].queue;
+
+  if (!image.imported && image.state.layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+    // nothing to keep, whichever queue uses it first takes it
+    if (image.state.batch == NONE) {
+      image.state.queue = queue;
+    }
+    wait_for_aliased(image, info, batch);
+  }
+
+  if (image.state.queue != queue) {
+    const bool keepContents = image.state.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+    const uint32_t releasing =
+        change_queue(image.state, info, batch, keepContents);
+
+    VkImageMemoryBarrier2 barrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+    barrier.oldLayout = releasing != NONE ? image.state.layout
+                                          : VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = info.layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image.image;
+    barrier.subresourceRange = whole_image(image.format);
+
+    if (releasing != NONE) {
+      barrier.srcQueueFamilyIndex = _queues[index(image.state.queue)].family;
+      barrier.dstQueueFamilyIndex = _queues[index(queue)].family;
+
+      VkImageMemoryBarrier2 release = barrier;
+      release.srcStageMask =
+          image.state.writeStages | image.state.readStages;
+      release.srcAccessMask = image.state.writeAccess;
+      release.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+      release.dstAccessMask = 0;
+      _releases.push_back(release);
+      _releaseBatches.push_back(releasing);
+    }
+
+    // the acquire, or just the layout. chained to the semaphore wait
+    barrier.srcStageMask = info.stages;
+    barrier.srcAccessMask = 0;
+    barrier.dstStageMask = info.stages;
+    barrier.dstAccessMask = info.readAccess | info.writeAccess;
+    _barriers.push_back(barrier);
+
+    acquired(image.state, info, queue, batch);
+    return;
+  }
+  image.state.batch = batch;
+
+  VkPipelineStageFlags2 srcStages{};
+  VkAccessFlags2 srcAccess{};
+  VkImageLayout oldLayout{};
+  if (!sync(image.state, info, srcStages, srcAccess, oldLayout)) {
+    return;
+  }
+
+  VkImageMemoryBarrier2 barrier{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+  barrier.srcStageMask = srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_2_NONE;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstStageMask = info.stages;
+  barrier.dstAccessMask = info.readAccess | info.writeAccess;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = info.layout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image.image;
+  barrier.subresourceRange = whole_image(image.format);
+  _barriers.push_back(barrier);
+}
+
+void RenderGraph::add_barriers(Buffer &buffer, BufferAccess access,
+                               uint32_t batch) {
+  const AccessInfo info = access_info(access, batch);
+  const PassQueue queue = _batches[batch].queue;
+
+  if (buffer.state.queue != queue) {
+    const uint32_t releasing =
+        change_queue(buffer.state, info, batch, buffer.written);
+    buffer.written |= info.writeAccess != 0;
+
+    // without contents to keep the semaphore wait is all it takes
+    if (releasing != NONE) {
+      VkBufferMemoryBarrier2 barrier{
+          .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+      barrier.srcQueueFamilyIndex = _queues[index(buffer.state.queue)].family;
+      barrier.dstQueueFamilyIndex = _queues[index(queue)].family;
+      barrier.buffer = buffer.buffer;
+      barrier.offset = 0;
+      barrier.size = VK_WHOLE_SIZE;
+
+      VkBufferMemoryBarrier2 release = barrier;
+      release.srcStageMask =
+          buffer.state.writeStages | buffer.state.readStages;
+      release.srcAccessMask = buffer.state.writeAccess;
+      release.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+      release.dstAccessMask = 0;
+      _bufferReleases.push_back(release);
+      _bufferReleaseBatches.push_back(releasing);
+
+      barrier.srcStageMask = info.stages;
+      barrier.srcAccessMask = 0;
+      barrier.dstStageMask = info.stages;
+      barrier.dstAccessMask = info.readAccess | info.writeAccess;
+      _bufferBarriers.push_back(barrier);
+    }
+
+    acquired(buffer.state, info, queue, batch);
+    return;
+  }
+  buffer.state.batch = batch;
+  buffer.written |= info.writeAccess != 0;
+
+  VkPipelineStageFlags2 srcStages{};
+  VkAccessFlags2 srcAccess{};
+  VkImageLayout oldLayout{};
+  if (!sync(buffer.state, info, srcStages, srcAccess, oldLayout)) {
+    return;
+  }
+
+  VkBufferMemoryBarrier2 barrier{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+  barrier.srcStageMask = srcStages;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstStageMask = info.stages;
+  barrier.dstAccessMask = info.readAccess | info.writeAccess;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = buffer.buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+  _bufferBarriers.push_back(barrier);
+}
+
+void RenderGraph::add_final_barriers() {
+  for (const Image &image : _images) {
+    if (!image.imported) {
+      continue;
+    }
+    const bool transfer = image.state.queue != PassQueue::Graphics;
+    const VkImageLayout finalLayout =
+        image.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED ? image.finalLayout
+                                                       : image.state.layout;
+    if (!transfer && finalLayout == image.state.layout) {
+      continue;
+    }
+
+    // whatever follows the graph, e.g. the semaphore signal before present,
+    // waits for the transition
+    VkImageMemoryBarrier2 barrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+    barrier.srcStageMask =
+        image.state.writeStages | image.state.readStages;
+    barrier.srcAccessMask = image.state.writeAccess;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = image.state.layout;
+    barrier.newLayout = finalLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image.image;
+    barrier.subresourceRange = whole_image(image.format);
+
+    if (transfer) {
+      barrier.srcQueueFamilyIndex = _queues[index(image.state.queue)].family;
+      barrier.dstQueueFamilyIndex =
+          _queues[index(PassQueue::Graphics)].family;
+
+      VkImageMemoryBarrier2 release = barrier;
+      release.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+      _releases.push_back(release);
+      _releaseBatches.push_back(image.state.batch);
+      _stats.queueTransfers++;
+
+      // the last batch waited for all of the other queue
+      barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+      barrier.srcAccessMask = 0;
+    }
+    _barriers.push_back(barrier);
+  }
+
+  for (const Buffer &buffer : _buffers) {
+    if (buffer.state.queue == PassQueue::Graphics || !buffer.written) {
+      continue;
+    }
+
+    VkBufferMemoryBarrier2 barrier{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+    barrier.srcStageMask =
+        buffer.state.writeStages | buffer.state.readStages;
+    barrier.srcAccessMask = buffer.state.writeAccess;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+    barrier.dstAccessMask = 0;
+    barrier.srcQueueFamilyIndex = _queues[index(buffer.state.queue)].family;
+    barrier.dstQueueFamilyIndex = _queues[index(PassQueue::Graphics)].family;
+    barrier.buffer = buffer.buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    _bufferReleases.push_back(barrier);
+    _bufferReleaseBatches.push_back(buffer.state.batch);
+    _stats.queueTransfers++;
+
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    barrier.srcAccessMask = 0;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    _bufferBarriers.push_back(barrier);
+  }
+}
+
+VkCommandBuffer RenderGraph::command_buffer(PassQueue queue, uint32_t i) {
+  FrameSlot &slot = _slots.at(_slot);
+  std::vector<VkCommandBuffer> &buffers = slot.commandBuffers[index(queue)];
+  if (i == buffers.size()) {
+    VkCommandBufferAllocateInfo allocInfo =
+        vkini::command_buffer_allocate_info(slot.pools[index(queue)], 1);
+    VkCommandBuffer cmd{};
+    vk_check(vkAllocateCommandBuffers(_device, &allocInfo, &cmd));
+    buffers.push_back(cmd);
+  }
+  return buffers[i];
+}
+
+void RenderGraph::execute(GpuProfiler *profiler, RecordFunction &&prologue,
+                          RecordFunction &&epilogue) {
+  auto barrier = [](VkCommandBuffer cmd,
+                    std::span<const VkImageMemoryBarrier2> images,
+                    std::span<const VkBufferMemoryBarrier2> buffers) {
+    if (images.empty() && buffers.empty()) {
+      return;
+    }
+    VkDependencyInfo dependency{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    dependency.imageMemoryBarrierCount = static_cast<uint32_t>(images.size());
+    dependency.pImageMemoryBarriers = images.data();
+    dependency.bufferMemoryBarrierCount =
+        static_cast<uint32_t>(buffers.size());
+    dependency.pBufferMemoryBarriers = buffers.data();
+    vkCmdPipelineBarrier2(cmd, &dependency);
+  };
+
+  std::array<uint32_t, PASS_QUEUES> used{};
+  size_t next = 0;
+  for (uint32_t b = 0; b < _batches.size(); b++) {
+    Batch &batch = _batches[b];
+    const bool graphics = batch.queue == PassQueue::Graphics;
+    const bool last = b + 1 == _batches.size();
+
+    VkCommandBuffer cmd =
+        command_buffer(batch.queue, used[index(batch.queue)]++);
+    batch.cmd = cmd;
+    VkCommandBufferBeginInfo beginInfo = vkini::command_buffer_begin_info(
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    vk_check(vkBeginCommandBuffer(cmd, &beginInfo));
+
+    if (b == 0 && prologue) {
+      prologue(cmd);
+    }
+    // pipeline statistics queries need a graphics queue
+    if (graphics && profiler) {
+      profiler->begin_statistics(cmd);
+    }
+
+    for (; next < _passes.size(); next++) {
+      Pass &pass = _passes[next];
+      if (pass.culled) {
+        continue;
+      }
+      if (pass.batch != b) {
+        break;
+      }
+      barrier(cmd,
+              std::span(_barriers).subspan(pass.firstBarrier,
+                                           pass.barrierCount),
+              std::span(_bufferBarriers)
+                  .subspan(pass.firstBufferBarrier, pass.bufferBarrierCount));
+
+      const uint32_t scope = profiler ? profiler->begin(cmd, pass.name) : 0;
+      pass.record(cmd);
+      if (profiler) {
+        profiler->end(cmd, scope);
+      }
+    }
+
+    // hand what the other queue uses next over to it
+    _batchReleases.clear();
+    for (size_t i = 0; i < _releases.size(); i++) {
+      if (_releaseBatches[i] == b) {
+        _batchReleases.push_back(_releases[i]);
+      }
+    }
+    _batchBufferReleases.clear();
+    for (size_t i = 0; i < _bufferReleases.size(); i++) {
+      if (_bufferReleaseBatches[i] == b) {
+        _batchBufferReleases.push_back(_bufferReleases[i]);
+      }
+    }
+    barrier(cmd, _batchReleases, _batchBufferReleases);
+
+    if (last) {
+      barrier(cmd, std::span(_barriers).subspan(_firstFinalBarrier),
+              std::span(_bufferBarriers).subspan(_firstFinalBufferBarrier));
+    }
+    if (graphics && profiler) {
+      profiler->end_statistics(cmd);
+    }
+    if (last && epilogue) {
+      epilogue(cmd);
+    }
+
+    vk_check(vkEndCommandBuffer(cmd));
+  }
+}
+
+void RenderGraph::submit(std::span<const VkSemaphoreSubmitInfo> waits,
+                         std::span<const VkSemaphoreSubmitInfo> signals) {
+  for (uint32_t b = 0; b < _batches.size(); b++) {
+    const Batch &batch = _batches[b];
+    const bool last = b + 1 == _batches.size();
+
+    _waitInfos.clear();
+    _signalInfos.clear();
+    if (batch.waitValue != 0) {
+      VkSemaphoreSubmitInfo wait = vkini::semaphore_submit_info(
+          batch.waitStages, _timelines[index(other(batch.queue))]);
+      wait.value = batch.waitValue;
+      _waitInfos.push_back(wait);
+    }
+    if (batch.signalValue != 0) {
+      VkSemaphoreSubmitInfo signal = vkini::semaphore_submit_info(
+          VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+          _timelines[index(batch.queue)]);
+      signal.value = batch.signalValue;
+      _signalInfos.push_back(signal);
+    }
+    if (last) {
+      _waitInfos.insert(_waitInfos.end(), waits.begin(), waits.end());
+      _signalInfos.insert(_signalInfos.end(), signals.begin(), signals.end());
+    }
+
+    VkCommandBufferSubmitInfo cmdInfo =
+        vkini::command_buffer_submit_info(batch.cmd);
+    VkSubmitInfo2 submit = vkini::submit_info(&cmdInfo, nullptr, nullptr);
+    submit.waitSemaphoreInfoCount = static_cast<uint32_t>(_waitInfos.size());
+    submit.pWaitSemaphoreInfos = _waitInfos.data();
+    submit.signalSemaphoreInfoCount =
+        static_cast<uint32_t>(_signalInfos.size());
+    submit.pSignalSemaphoreInfos = _signalInfos.data();
+    vk_check(
+        vkQueueSubmit2(_queues[index(batch.queue)].queue, 1, &submit, nullptr));
+  }
+}
+
+VkImage RenderGraph::image(ImageHandle handle) const {
+  return _images.at(handle.index).image;
+}
+
+VkImageView RenderGraph::view(ImageHandle handle) const {
+  return _images.at(handle.index).view;
+}
+
+VkExtent2D RenderGraph::extent(ImageHandle handle) const {
+  return _images.at(handle.index).extent;
+}
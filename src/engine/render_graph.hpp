@@ -0,0 +1,393 @@
+#pragma once
+
+#include <vk_mem_alloc.h>
+#include <volk.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "memory_stats.hpp"
+
+class GpuProfiler;
+
+// how a pass uses an image. picks the layout the image has to be in and the
+// stages and access masks of the barriers around the pass
+enum class ImageAccess : uint8_t {
+  TransferSrc,
+  TransferDst,
+  // loaded and stored, so it reads the previous contents too
+  ColorAttachment,
+  // storage image reads and writes from compute shaders
+  ComputeRead,
+  ComputeWrite,
+  // sampled from fragment or compute shaders
+  Sampled,
+  // depth tested and written
+  DepthAttachment,
+  // depth tested without writing, e.g. after a depth prepass
+  DepthRead,
+};
+
+// how a pass uses a buffer. buffers have no layouts, only the stages and
+// access masks of the barriers follow from it
+enum class BufferAccess : uint8_t {
+  IndirectRead,
+  // storage buffer access from compute shaders
+  ComputeRead,
+  ComputeWrite,
+  ComputeReadWrite,
+};
+
+// the queues passes run on
+enum class PassQueue : uint8_t {
+  Graphics,
+  // async compute, see RenderGraph::PassBuilder::async
+  Compute,
+};
+
+constexpr uint32_t PASS_QUEUES = 2;
+
+// a queue the graph submits to, and the family it is from
+struct RenderQueue {
+  VkQueue queue;
+  uint32_t family;
+};
+
+// an image of the graph currently being built
+struct ImageHandle {
+  uint32_t index;
+};
+
+// a buffer of the graph currently being built
+struct BufferHandle {
+  uint32_t index;
+};
+
+struct RenderGraphStats {
+  uint32_t passes;
+  // passes nothing that is kept depends on
+  uint32_t culledPasses;
+  // one vkCmdPipelineBarrier2 each
+  uint32_t barrierBatches;
+  uint32_t imageBarriers;
+  uint32_t bufferBarriers;
+  // submissions, a new one whenever the queue changes between passes
+  uint32_t batches;
+  uint32_t asyncPasses;
+  // ownership transfers between the graphics and compute queue families,
+  // each a release and an acquire barrier
+  uint32_t queueTransfers;
+  // memory the transient images share, and what they would take unaliased
+  VkDeviceSize transientBytes;
+  VkDeviceSize transientUnaliasedBytes;
+};
+
+// the passes of one frame and the images they use. passes declare how they
+// access images and run in the order they were added. compile culls passes
+// whose results nobody uses, places transient images into shared memory where
+// their lifetimes don't overlap and works out the barriers, which execute
+// records batched in front of each pass.
+//
+// with an async compute queue, passes that opt in run there. consecutive
+// passes on the same queue form a batch, one command buffer and submission.
+// batches wait on the other queue's timeline semaphore only for what they
+// use from it, resources change queue families with release and acquire
+// barriers, so compute and raster work without dependencies between them
+// overlap. between frames resources belong to the graphics queue family,
+// the first batch releases them and the last one, always on the graphics
+// queue, takes them back and waits for everything else.
+//
+// built anew every frame. the vectors keep their capacity and transient
+// images are only recreated when the frame's transients change, so an
+// unchanged frame doesn't allocate
+class RenderGraph {
+ public:
+  using RecordFunction = std::function<void(VkCommandBuffer cmd)>;
+
+  // declares the images a pass uses, before the next pass is added
+  class PassBuilder {
+   public:
+    PassBuilder(RenderGraph &graph, uint32_t pass)
+        : _graph{graph}, _pass{pass} {}
+
+    PassBuilder &use(ImageHandle image, ImageAccess access);
+    PassBuilder &use(BufferHandle buffer, BufferAccess access);
+
+    // runs the pass on the async compute queue if there is one, it may only
+    // record compute and transfer work then
+    PassBuilder &async();
+
+   private:
+    RenderGraph &_graph;
+    uint32_t _pass;
+  };
+
+  // transient images and command buffers come in frameCount sets, one per
+  // frame in flight. without compute every pass runs on graphics, compute
+  // has to be from another queue family
+  RenderGraph(VkDevice device, VmaAllocator allocator,
+              MemoryStats &memoryStats, uint32_t frameCount,
+              RenderQueue graphics, std::optional<RenderQueue> compute);
+  RenderGraph(const RenderGraph &) = delete;
+  RenderGraph(RenderGraph &&) = delete;
+  RenderGraph &operator=(const RenderGraph &) = delete;
+  RenderGraph &operator=(RenderGraph &&) = delete;
+  // the gpu has to be done with every frame
+  ~RenderGraph();
+
+  // drops the previous frame's passes and images. frameSlot picks the
+  // transient memory and command buffers, the slot's previous frame has to
+  // be complete
+  void reset(uint32_t frameSlot);
+
+  [[nodiscard]] bool has_async_compute() const {
+    return _queues[1].queue != VK_NULL_HANDLE;
+  }
+
+  // an image owned elsewhere, in layout when the graph starts. lastStages
+  // are the stages that used it before, the first barrier waits for them.
+  // for acquired swapchain images that is the semaphore wait stage. it is
+  // left in finalLayout, UNDEFINED leaves it in whatever the last pass used.
+  // imported images are the outputs of the graph, passes writing them are
+  // never culled. barriers cover all of its mips
+  ImageHandle import_image(VkImage image, VkImageView view, VkFormat format,
+                           VkExtent2D extent, VkImageLayout layout,
+                           VkPipelineStageFlags2 lastStages,
+                           VkImageLayout finalLayout);
+
+  // a buffer owned elsewhere. like imported images it counts as an output,
+  // lastStages are the stages that used it before the graph
+  BufferHandle import_buffer(VkBuffer buffer,
+                             VkPipelineStageFlags2 lastStages);
+
+  // an image that only lives within the frame. its contents are undefined
+  // at the first use and it may share memory with other transient images.
+  // the usage flags follow from the passes using it
+  ImageHandle create_image(VkFormat format, VkExtent2D extent);
+
+  // name has to outlive the frame's gpu profiler readback, use string
+  // literals. record runs during execute
+  PassBuilder add_pass(const char *name, RecordFunction &&record);
+
+  void compile();
+
+  // records the passes that survived compile into the batches' command
+  // buffers, each in its own gpu profiler scope if profiler isn't null.
+  // prologue is recorded first and epilogue last, both on graphics, e.g. to
+  // time the whole frame
+  void execute(GpuProfiler *profiler, RecordFunction &&prologue,
+               RecordFunction &&epilogue);
+
+  // submits the batches in order. waits and signals go with the last batch,
+  // which runs after all others, so an imported image a wait guards has to
+  // be first used in it, like the swapchain image in the final passes
+  void submit(std::span<const VkSemaphoreSubmitInfo> waits,
+              std::span<const VkSemaphoreSubmitInfo> signals);
+
+  // valid after compile, transient images are only created then
+  [[nodiscard]] VkImage image(ImageHandle handle) const;
+  [[nodiscard]] VkImageView view(ImageHandle handle) const;
+  [[nodiscard]] VkExtent2D extent(ImageHandle handle) const;
+
+  // of the last compile
+  [[nodiscard]] const RenderGraphStats &stats() const { return _stats; }
+
+ private:
+  static constexpr uint32_t NONE = UINT32_MAX;
+
+  // stages and access masks of a use, and the layout images have to be in
+  struct AccessInfo {
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2 readAccess;
+    VkAccessFlags2 writeAccess;
+    VkImageLayout layout;
+    VkImageUsageFlags usage;
+  };
+
+  // what the barriers in front of the next use have to wait for. buffers
+  // stay in VK_IMAGE_LAYOUT_UNDEFINED
+  struct SyncState {
+    // whose family owns it, and the batch that last used it. NONE before the
+    // graph, when it is on graphics
+    PassQueue queue;
+    uint32_t batch;
+    VkImageLayout layout;
+    // last write, or layout transition, and the reads since
+    VkPipelineStageFlags2 writeStages;
+    VkAccessFlags2 writeAccess;
+    VkPipelineStageFlags2 readStages;
+    // already made visible to these since the last write
+    VkPipelineStageFlags2 visibleStages;
+    VkAccessFlags2 visibleAccess;
+  };
+
+  struct Image {
+    VkImage image;
+    VkImageView view;
+    VkExtent2D extent;
+    VkFormat format;
+    bool imported;
+    VkImageLayout finalLayout;
+    SyncState state;
+    // of transient images, from the passes that are kept
+    VkImageUsageFlags usage;
+    uint32_t firstPass;
+    uint32_t lastPass;
+    // index in the frame slot's transients
+    uint32_t transient;
+  };
+
+  struct Buffer {
+    VkBuffer buffer;
+    SyncState state;
+    // has contents to keep when it changes queues
+    bool written;
+  };
+
+  struct Use {
+    uint32_t image;
+    ImageAccess access;
+  };
+
+  struct BufferUse {
+    uint32_t buffer;
+    BufferAccess access;
+  };
+
+  struct Pass {
+    const char *name;
+    RecordFunction record;
+    PassQueue queue;
+    uint32_t batch;
+    uint32_t firstUse;
+    uint32_t useCount;
+    uint32_t firstBufferUse;
+    uint32_t bufferUseCount;
+    bool culled;
+    uint32_t firstBarrier;
+    uint32_t barrierCount;
+    uint32_t firstBufferBarrier;
+    uint32_t bufferBarrierCount;
+  };
+
+  // what the transients of a frame look like, a slot's images are reused
+  // while this stays the same
+  struct TransientKey {
+    VkFormat format;
+    VkExtent2D extent;
+    VkImageUsageFlags usage;
+    uint32_t firstPass;
+    uint32_t lastPass;
+
+    bool operator==(const TransientKey &other) const;
+  };
+
+  struct TransientImage {
+    VkImage image;
+    VkImageView view;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    VkDeviceSize alignment;
+  };
+
+  struct Batch {
+    PassQueue queue;
+    // the other queue's timeline value to wait for, 0 for none, and the
+    // stages of this batch that wait
+    uint64_t waitValue;
+    VkPipelineStageFlags2 waitStages;
+    // this batch's value on its queue's timeline
+    uint64_t signalValue;
+    VkCommandBuffer cmd;
+  };
+
+  struct FrameSlot {
+    // one per queue
+    std::array<VkCommandPool, PASS_QUEUES> pools{};
+    std::array<std::vector<VkCommandBuffer>, PASS_QUEUES> commandBuffers;
+    std::vector<TransientKey> keys;
+    std::vector<TransientImage> images;
+    VmaAllocation allocation{};
+    VkDeviceSize bytes{0};
+    VkDeviceSize unaliasedBytes{0};
+  };
+
+  static AccessInfo access_info(ImageAccess access);
+  static AccessInfo access_info(BufferAccess access);
+  // moves state past a use. returns whether a barrier has to go in front of
+  // it, waiting for srcStages and srcAccess and transitioning from oldLayout
+  static bool sync(SyncState &state, const AccessInfo &info,
+                   VkPipelineStageFlags2 &srcStages, VkAccessFlags2 &srcAccess,
+                   VkImageLayout &oldLayout);
+
+  // the access as a pass in batch sees it, compute queues only have some of
+  // the stages
+  [[nodiscard]] AccessInfo access_info(ImageAccess access,
+                                       uint32_t batch) const;
+  [[nodiscard]] AccessInfo access_info(BufferAccess access,
+                                       uint32_t batch) const;
+
+  void cull();
+  void form_batches();
+  void place_transients();
+  void create_transients(FrameSlot &slot);
+  void destroy_transients(FrameSlot &slot);
+  // makes the first use of a transient image wait for the images that used
+  // its memory before
+  void wait_for_aliased(Image &image, const AccessInfo &info, uint32_t batch);
+  // makes batch wait for the other queue's last use of state. returns the
+  // batch that has to release it, NONE when its contents aren't kept
+  uint32_t change_queue(SyncState &state, const AccessInfo &info,
+                        uint32_t batch, bool keepContents);
+  // moves state past a use that took it over from the other queue
+  static void acquired(SyncState &state, const AccessInfo &info,
+                       PassQueue queue, uint32_t batch);
+  void add_barriers(Image &image, ImageAccess access, uint32_t batch);
+  void add_barriers(Buffer &buffer, BufferAccess access, uint32_t batch);
+  void add_final_barriers();
+  VkCommandBuffer command_buffer(PassQueue queue, uint32_t index);
+
+  VkDevice _device;
+  VmaAllocator _allocator;
+  MemoryStats &_memoryStats;
+  // graphics, then compute if there is an async compute queue
+  std::array<RenderQueue, PASS_QUEUES> _queues{};
+  // signaled by every batch when there is more than one
+  std::array<VkSemaphore, PASS_QUEUES> _timelines{};
+  std::array<uint64_t, PASS_QUEUES> _timelineValues{};
+
+  std::vector<FrameSlot> _slots;
+  uint32_t _slot{0};
+
+  std::vector<Image> _images;
+  std::vector<Buffer> _buffers;
+  std::vector<Use> _uses;
+  std::vector<BufferUse> _bufferUses;
+  std::vector<Pass> _passes;
+  std::vector<Batch> _batches;
+  std::vector<VkImageMemoryBarrier2> _barriers;
+  std::vector<VkBufferMemoryBarrier2> _bufferBarriers;
+  // barriers after the last pass, into the final layouts and back to the
+  // graphics queue family
+  uint32_t _firstFinalBarrier{0};
+  uint32_t _firstFinalBufferBarrier{0};
+  // ownership releases, recorded at the end of the batch next to them
+  std::vector<VkImageMemoryBarrier2> _releases;
+  std::vector<uint32_t> _releaseBatches;
+  std::vector<VkBufferMemoryBarrier2> _bufferReleases;
+  std::vector<uint32_t> _bufferReleaseBatches;
+  // scratch for execute and submit
+  std::vector<VkImageMemoryBarrier2> _batchReleases;
+  std::vector<VkBufferMemoryBarrier2> _batchBufferReleases;
+  std::vector<VkSemaphoreSubmitInfo> _waitInfos;
+  std::vector<VkSemaphoreSubmitInfo> _signalInfos;
+  // scratch for compile
+  std::vector<TransientKey> _keys;
+  std::vector<bool> _needed;
+
+  RenderGraphStats _stats{};
+};
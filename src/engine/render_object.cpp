@@ -0,0 +1,81 @@
+#include "render_object.hpp"
+
+namespace {
+
+// the smallest maxDrawIndirectCount devices with multiDrawIndirect have
+constexpr size_t MAX_DRAWS_PER_INDIRECT = 65'535;
+
+bool same_state(const RenderObject& a, const RenderObject& b,
+                bool depthPrepass) {
+  const VkPipeline pipelineA = depthPrepass ? a.depthPipeline : a.pipeline;
+  const VkPipeline pipelineB = depthPrepass ? b.depthPipeline : b.pipeline;
+  return pipelineA == pipelineB && a.layout == b.layout &&
+         a.vertexBuffer == b.vertexBuffer && a.indexBuffer == b.indexBuffer;
+}
+
+}  // namespace
+
+void record_draws(VkCommandBuffer cmd, std::span<const RenderObject> objects,
+                  const BindlessTable& bindless, const IndirectDraws& indirect,
+                  bool depthPrepass) {
+  VkPipeline lastPipeline{};
+  VkPipelineLayout lastLayout{};
+  VkBuffer lastVertexBuffer{};
+  VkBuffer lastIndexBuffer{};
+
+  size_t first = 0;
+  while (first < objects.size()) {
+    const RenderObject& object = objects[first];
+    size_t end = first + 1;
+    while (end < objects.size() && end - first < MAX_DRAWS_PER_INDIRECT &&
+           same_state(object, objects[end], depthPrepass)) {
+      end++;
+    }
+
+    VkPipeline pipeline = depthPrepass ? object.depthPipeline : object.pipeline;
+    if (pipeline == VK_NULL_HANDLE) {
+      first = end;
+      continue;
+    }
+
+    if (pipeline != lastPipeline) {
+      lastPipeline = pipeline;
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    }
+
+    if (object.layout != lastLayout) {
+      lastLayout = object.layout;
+      // the bindless table never changes, only layouts can make it necessary
+      // to bind it again
+      bindless.bind(cmd, object.layout);
+
+      const DrawPushConstants constants{.draws = indirect.draws,
+                                        .camera = indirect.camera};
+      vkCmdPushConstants(
+          cmd, object.layout,
+          VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+          sizeof(constants), &constants);
+    }
+
+    if (object.vertexBuffer != lastVertexBuffer &&
+        object.vertexBuffer != VK_NULL_HANDLE) {
+      lastVertexBuffer = object.vertexBuffer;
+      VkDeviceSize offset{0};
+      vkCmdBindVertexBuffers(cmd, 0, 1, &object.vertexBuffer, &offset);
+    }
+
+    if (object.indexBuffer != lastIndexBuffer) {
+      lastIndexBuffer = object.indexBuffer;
+      vkCmdBindIndexBuffer(cmd, object.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    }
+
+    // culled objects are still drawn, with no instances
+    vkCmdDrawIndexedIndirect(
+        cmd, indirect.commands,
+        indirect.offset + first * sizeof(VkDrawIndexedIndirectCommand),
+        static_cast<uint32_t>(end - first),
+        sizeof(VkDrawIndexedIndirectCommand));
+
+    first = end;
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <volk.h>
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+#include "bindless.hpp"
+#include "material.hpp"
+
+// per object data the shaders read from a buffer, indexed by the draw's
+// firstInstance. std430 layout, keep in sync with colored_triangle.vert/frag,
+// colored_triangle_pulled.vert and cull.comp. std430 aligns the struct like
+// its matrix, to 16 bytes
+struct alignas(16) DrawData {
+  // object to world, the camera's view projection is applied on the gpu
+  glm::mat4 model;
+  // object space bounding box, w unused
+  glm::vec4 boundsMin;
+  glm::vec4 boundsMax;
+  glm::vec3 col;
+  MaterialFeatures features;
+  // slots in the bindless table
+  uint32_t textureIndex;
+  uint32_t samplerIndex;
+  // copied into the draw's indirect command
+  uint32_t indexCount;
+  uint32_t firstIndex;
+  // of the first Vertex, read by the vertex shader with vertex pulling
+  VkDeviceAddress vertices;
+};
+static_assert(sizeof(DrawData) == 144);
+
+// push constant block of colored_triangle.vert/frag
+struct DrawPushConstants {
+  // of the frame's DrawData array
+  VkDeviceAddress draws;
+  // of the frame's CameraData
+  VkDeviceAddress camera;
+};
+
+// everything needed to record one draw. objects fill these in every frame and
+// the engine records them, possibly split over several threads
+struct RenderObject {
+  VkPipeline pipeline;
+  // draws it in the depth prepass, null if it isn't part of it
+  VkPipeline depthPipeline;
+  VkPipelineLayout layout;
+  // null when the pipeline pulls its vertices from draw.vertices
+  VkBuffer vertexBuffer;
+  VkBuffer indexBuffer;
+  DrawData draw;
+};
+
+struct DrawContext {
+  std::vector<RenderObject> objects;
+};
+
+// where the draws of a frame read their data, written by DrawCulling
+struct IndirectDraws {
+  VkDeviceAddress draws;
+  VkDeviceAddress camera;
+  // a VkDrawIndexedIndirectCommand per object of the draw list, culled
+  // objects have no instances
+  VkBuffer commands;
+  // of the first object's command
+  VkDeviceSize offset;
+};
+
+// records the draws, only rebinding state that changed between neighbours.
+// runs of objects sharing all of it become a single multi draw. viewport and
+// scissor have to be set already. for the depth prepass only the objects
+// with a depthPipeline are drawn, with that pipeline
+void record_draws(VkCommandBuffer cmd, std::span<const RenderObject> objects,
+                  const BindlessTable &bindless, const IndirectDraws &indirect,
+                  bool depthPrepass = false);
@@ -0,0 +1,79 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+// feature bits, keep in sync with MaterialFeatureBits in material.hpp
+const uint FEATURE_TEXTURED = 1;
+const uint FEATURE_VERTEX_COLOR = 2;
+
+// set per pipeline so the unused paths get compiled out
+layout(constant_id = 0) const uint MATERIAL_FEATURES = FEATURE_TEXTURED;
+// the uber variant ignores MATERIAL_FEATURES and branches on the draw's
+// features
+layout(constant_id = 1) const bool UBER_SHADER = false;
+
+// the bindless table, see BindlessTable in bindless.hpp
+layout(set = 0, binding = 0) uniform texture2D textures[];
+layout(set = 0, binding = 1) uniform sampler samplers[];
+
+// only read by the vertex shader with vertex pulling
+layout(buffer_reference) buffer VertexBuffer;
+
+// per object data, keep in sync with DrawData in render_object.hpp
+struct DrawData
+{
+	mat4 model;
+	vec4 boundsMin;
+	vec4 boundsMax;
+	vec3 col;
+	uint features;
+	uint textureIndex;
+	uint samplerIndex;
+	uint indexCount;
+	uint firstIndex;
+	VertexBuffer vertices;
+};
+
+layout(buffer_reference, std430) readonly buffer DrawBuffer
+{
+	DrawData draws[];
+};
+
+layout( push_constant ) uniform constants
+{
+ DrawBuffer drawBuffer;
+} PushConstants;
+
+//shader input
+layout (location = 0) in vec4 inColor;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) flat in uint inDrawIndex;
+
+//output write
+layout (location = 0) out vec4 outColor;
+
+bool has_feature(uint feature)
+{
+	if (UBER_SHADER) {
+		return (PushConstants.drawBuffer.draws[inDrawIndex].features &
+		        feature) != 0;
+	}
+	return (MATERIAL_FEATURES & feature) != 0;
+}
+
+void main() 
+{
+	outColor = vec4(1.0);
+
+	if (has_feature(FEATURE_VERTEX_COLOR)) {
+		outColor *= inColor;
+	}
+
+	if (has_feature(FEATURE_TEXTURED)) {
+		// draws of one multi draw can use different textures
+		DrawData draw = PushConstants.drawBuffer.draws[inDrawIndex];
+		outColor *= texture(sampler2D(textures[nonuniformEXT(draw.textureIndex)],
+		                              samplers[nonuniformEXT(draw.samplerIndex)]),
+		                    inTexCoord);
+	}
+}
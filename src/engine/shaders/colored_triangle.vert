@@ -0,0 +1,67 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 2) in vec4 inColor;
+layout(location = 4) in vec2 inTexCoord;
+
+layout (location = 0) out vec4 outColor;
+layout (location = 2) out vec2 outTexCoord;
+// which DrawData the fragment shader reads
+layout (location = 3) flat out uint outDrawIndex;
+
+// the depth prepass and the color pass after it compare depth for equality,
+// both have to compute exactly the same position
+invariant gl_Position;
+
+// only read with vertex pulling, see colored_triangle_pulled.vert
+layout(buffer_reference) buffer VertexBuffer;
+
+// per object data, keep in sync with DrawData in render_object.hpp
+struct DrawData
+{
+	mat4 model;
+	vec4 boundsMin;
+	vec4 boundsMax;
+	vec3 col;
+	uint features;
+	uint textureIndex;
+	uint samplerIndex;
+	uint indexCount;
+	uint firstIndex;
+	VertexBuffer vertices;
+};
+
+layout(buffer_reference, std430) readonly buffer DrawBuffer
+{
+	DrawData draws[];
+};
+
+// keep in sync with CameraData and FRUSTUM_PLANES in camera.hpp
+const uint FRUSTUM_PLANES = 5;
+
+layout(buffer_reference, std430) readonly buffer CameraBuffer
+{
+	mat4 viewProj;
+	vec4 frustum[FRUSTUM_PLANES];
+	vec4 position;
+};
+
+layout( push_constant ) uniform constants
+{
+ DrawBuffer drawBuffer;
+ CameraBuffer camera;
+} PushConstants;
+
+void main() 
+{
+	// every draw is a single instance whose firstInstance is its index
+	DrawData draw = PushConstants.drawBuffer.draws[gl_InstanceIndex];
+
+	//output the position of each vertex
+	gl_Position = PushConstants.camera.viewProj *
+	              (draw.model * vec4(inPosition, 1.0f));
+	outColor = inColor;
+	outTexCoord = inTexCoord;
+	outDrawIndex = gl_InstanceIndex;
+}
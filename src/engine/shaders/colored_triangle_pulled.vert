@@ -0,0 +1,88 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+
+// colored_triangle.vert with the vertices read from the draw's vertex buffer
+// address instead of fixed function vertex input, so the pipeline has no
+// vertex input state and draws of different buffers need no rebinding
+
+layout (location = 0) out vec4 outColor;
+layout (location = 2) out vec2 outTexCoord;
+// which DrawData the fragment shader reads
+layout (location = 3) flat out uint outDrawIndex;
+
+// the depth prepass and the color pass after it compare depth for equality,
+// both have to compute exactly the same position
+invariant gl_Position;
+
+// Vertex in struct.hpp is tightly packed floats, which std430 can't express
+// as a struct, so it is read a float at a time. keep in sync with it
+const uint VERTEX_FLOATS = 9;
+const uint POSITION_OFFSET = 0;
+const uint COLOR_OFFSET = 3;
+const uint TEX_COORD_OFFSET = 7;
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer
+{
+	float floats[];
+};
+
+// per object data, keep in sync with DrawData in render_object.hpp
+struct DrawData
+{
+	mat4 model;
+	vec4 boundsMin;
+	vec4 boundsMax;
+	vec3 col;
+	uint features;
+	uint textureIndex;
+	uint samplerIndex;
+	uint indexCount;
+	uint firstIndex;
+	VertexBuffer vertices;
+};
+
+layout(buffer_reference, std430) readonly buffer DrawBuffer
+{
+	DrawData draws[];
+};
+
+// keep in sync with CameraData and FRUSTUM_PLANES in camera.hpp
+const uint FRUSTUM_PLANES = 5;
+
+layout(buffer_reference, std430) readonly buffer CameraBuffer
+{
+	mat4 viewProj;
+	vec4 frustum[FRUSTUM_PLANES];
+	vec4 position;
+};
+
+layout( push_constant ) uniform constants
+{
+ DrawBuffer drawBuffer;
+ CameraBuffer camera;
+} PushConstants;
+
+void main() 
+{
+	// every draw is a single instance whose firstInstance is its index
+	DrawData draw = PushConstants.drawBuffer.draws[gl_InstanceIndex];
+
+	// the index buffer's value, the same index fixed function input uses
+	uint base = uint(gl_VertexIndex) * VERTEX_FLOATS;
+	VertexBuffer vertices = draw.vertices;
+	vec3 position = vec3(vertices.floats[base + POSITION_OFFSET],
+	                     vertices.floats[base + POSITION_OFFSET + 1],
+	                     vertices.floats[base + POSITION_OFFSET + 2]);
+	vec4 color = vec4(vertices.floats[base + COLOR_OFFSET],
+	                  vertices.floats[base + COLOR_OFFSET + 1],
+	                  vertices.floats[base + COLOR_OFFSET + 2],
+	                  vertices.floats[base + COLOR_OFFSET + 3]);
+	vec2 texCoord = vec2(vertices.floats[base + TEX_COORD_OFFSET],
+	                     vertices.floats[base + TEX_COORD_OFFSET + 1]);
+
+	gl_Position = PushConstants.camera.viewProj *
+	              (draw.model * vec4(position, 1.0f));
+	outColor = color;
+	outTexCoord = texCoord;
+	outDrawIndex = gl_InstanceIndex;
+}
@@ -6,52 +6,75 @@
 #include "helpers.hpp"
 #include "vulkan/ini.hpp"
 
-AllocatedImage::create(vk::Format format, vk::Extent3D extent,
-                       vk::ImageUsageFlags usages,
-                       VmaAllocationCreateInfo allocInfo,
-                       vk::ImageAspectFlags imageAspect) {
-  VkImageCreateInfo rimg_info = vkini::image_create_info(
-      VkFormat(format), VkImageUsageFlags(usages), VkExtent3D(extent));
-
-  // for the draw image, we want to allocate it from gpu local memory
-  VmaAllocationCreateInfo rimg_allocinfo = {};
-  rimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-  rimg_allocinfo.requiredFlags =
+AllocatedImage AllocatedImage::create(VkFormat format, VkExtent3D extent,
+                                      VkImageUsageFlags usages,
+                                      VkImageAspectFlags imageAspect,
+                                      MemoryCategory category) {
+  Engine& engine = Engine::instance();
+
+  AllocatedImage result{.extent = extent, .format = format};
+
+  VkImageCreateInfo imageInfo =
+      vkini::image_create_info(format, usages, extent);
+
+  VmaAllocationCreateInfo allocInfo = {};
+  allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+  allocInfo.requiredFlags =
       VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  allocInfo.pUserData = MemoryStats::user_data(category);
 
-  // allocate and create the image
-  vmaCreateImage(_allocator, &rimg_info, &rimg_allocinfo, &_drawImage.image,
-                 &_drawImage.allocation, nullptr);
+  vk_check(vmaCreateImage(engine._allocator, &imageInfo, &allocInfo,
+                          &result.image, &result.allocation, nullptr));
+  engine._memoryStats->track(result.allocation);
 
-  // build a image-view for the draw image to use for rendering
-  VkImageViewCreateInfo rview_info = vkini::imageview_create_info(
-      _drawImage.format, _drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
+  VkImageViewCreateInfo viewInfo =
+      vkini::imageview_create_info(format, result.image, imageAspect);
+  vk_check(vkCreateImageView(engine._device, &viewInfo, nullptr, &result.view));
 
-  vk_check(vkCreateImageView(_device, &rview_info, nullptr, &_drawImage.view));
+  return result;
+}
 
-  return AllocatedImage{
-      .extent = extent,
-      .format = format,
-      .view =
-          , .image =, .allocation =,
-  };
+void AllocatedImage::destroy() {
+  if (image == VK_NULL_HANDLE) {
+    return;
+  }
+  Engine& engine = Engine::instance();
+  vkDestroyImageView(engine._device, view, nullptr);
+  if (engine._memoryStats) {
+    engine._memoryStats->untrack(allocation);
+  }
+  vmaDestroyImage(engine._allocator, image, allocation);
+  *this = {};
 }
 
 AllocatedBuffer::AllocatedBuffer(size_t allocSize, VkBufferUsageFlags usage,
-                                 VmaMemoryUsage memoryUsage) {
+                                 VmaMemoryUsage memoryUsage,
+                                 MemoryCategory category,
+                                 std::span<const uint32_t> queueFamilies) {
+  Engine& engine = Engine::instance();
+
   VkBufferCreateInfo bufferInfo = {};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.pNext = nullptr;
   bufferInfo.size = allocSize;
 
   bufferInfo.usage = usage;
+  if (queueFamilies.size() > 1) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount =
+        static_cast<uint32_t>(queueFamilies.size());
+    bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+  }
 
   VmaAllocationCreateInfo vmaallocInfo = {};
   vmaallocInfo.usage = memoryUsage;
   vmaallocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+  vmaallocInfo.pUserData = MemoryStats::user_data(category);
 
-  vk_check(vmaCreateBuffer(Engine::instance()._allocator, &bufferInfo,
-                           &vmaallocInfo, &_buffer, &_allocation, &_info));
+  vk_check(vmaCreateBuffer(engine._allocator, &bufferInfo, &vmaallocInfo,
+                           &_buffer, &_allocation, &_info));
+
+  engine._memoryStats->track(_allocation);
 }
 
 AllocatedBuffer::AllocatedBuffer(AllocatedBuffer&& other) noexcept
@@ -65,5 +88,9 @@ AllocatedBuffer::~AllocatedBuffer() {
   if (_buffer == nullptr) {
     return;
   }
-  vmaDestroyBuffer(Engine::instance()._allocator, _buffer, _allocation);
+  Engine& engine = Engine::instance();
+  if (engine._memoryStats) {
+    engine._memoryStats->untrack(_allocation);
+  }
+  vmaDestroyBuffer(engine._allocator, _buffer, _allocation);
 }
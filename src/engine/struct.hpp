@@ -1,28 +1,38 @@
 #pragma once
 
 #include <vk_mem_alloc.h>
+#include <volk.h>
 
 #include <functional>
 #include <glm/glm.hpp>
 #include <glm/gtx/hash.hpp>
-#include <vulkan/vulkan.hpp>
-#include <vulkan/vulkan_enums.hpp>
+#include <span>
 
+#include "memory_stats.hpp"
+
+// plain handles, copied around freely. whoever created it calls destroy
 struct AllocatedImage {
-  AllocatedImage(vk::Format format, vk::Extent3D extent,
-                 vk::ImageUsageFlags usages, VmaAllocationCreateInfo allocInfo,
-                 vk::ImageAspectFlags imageAspect);
-  VkImage image;
-  VkImageView view;
-  VkExtent3D extent;
-  VkFormat format;
-  VmaAllocation allocation;
+  // device local, a single mip level and a view over all of it
+  static AllocatedImage create(VkFormat format, VkExtent3D extent,
+                               VkImageUsageFlags usages,
+                               VkImageAspectFlags imageAspect,
+                               MemoryCategory category);
+  void destroy();
+
+  VkImage image{};
+  VkImageView view{};
+  VkExtent3D extent{};
+  VkFormat format{};
+  VmaAllocation allocation{};
 };
 
 class AllocatedBuffer {
  public:
+  // shared between queueFamilies without ownership transfers if there is
+  // more than one
   AllocatedBuffer(size_t allocSize, VkBufferUsageFlags usage,
-                  VmaMemoryUsage memoryUsage);
+                  VmaMemoryUsage memoryUsage, MemoryCategory category,
+                  std::span<const uint32_t> queueFamilies = {});
   AllocatedBuffer(const AllocatedBuffer &) = delete;
   AllocatedBuffer(AllocatedBuffer &&) noexcept;
   AllocatedBuffer &operator=(const AllocatedBuffer &) = delete;
@@ -40,6 +50,7 @@ struct GPUMeshBuffers {
   VkDeviceAddress vertexBufferAddress;
 };
 
+// tightly packed, keep in sync with colored_triangle_pulled.vert
 struct Vertex {
   glm::vec3 position;
   // float uv_x;
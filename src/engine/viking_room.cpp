@@ -1,13 +1,24 @@
 #include "viking_room.hpp"
 
 #include <fmt/format.h>
+#include <tiny_obj_loader.h>
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan_core.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <expected>
 #include <glm/gtc/matrix_transform.hpp>
-
+#include <limits>
+#include <shaders/colored_triangle_frag.hpp>
+#include <shaders/colored_triangle_pulled_vert.hpp>
+#include <shaders/colored_triangle_vert.hpp>
+#include <span>
+#include <string>
+#include <unordered_map>
+
+#include "cpu_profiler.hpp"
 #include "engine.hpp"
 #include "helpers.hpp"
 #include "struct.hpp"
@@ -17,17 +28,30 @@
 VikingRoom::VikingRoom() { load_model(); }
 
 void VikingRoom::load_model() {
+  PROFILE_SCOPE("load viking room obj");
+
   tinyobj::attrib_t attrib;
   std::vector<tinyobj::shape_t> shapes;
   std::vector<tinyobj::material_t> materials;
   std::string warn;
   std::string err;
 
+  const std::string path = Engine::instance().asset_path(VIKING_MODEL);
   if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
-                        VIKING_MODEL.data())) {
+                        path.c_str())) {
     throw std::runtime_error(warn + err);
   }
 
+  // over every position in the file, not just the indexed ones
+  _boundsMin = glm::vec3(std::numeric_limits<float>::max());
+  _boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+  for (size_t i = 0; i + 2 < attrib.vertices.size(); i += 3) {
+    const glm::vec3 position{attrib.vertices[i], attrib.vertices[i + 1],
+                             attrib.vertices[i + 2]};
+    _boundsMin = glm::min(_boundsMin, position);
+    _boundsMax = glm::max(_boundsMax, position);
+  }
+
   std::unordered_map<Vertex, uint32_t> uniqueVertices{};
 
   for (const auto& shape : shapes) {
@@ -43,7 +67,7 @@ void VikingRoom::load_model() {
 
       vertex.color = {1., 1., 1., 1.};
 
-      if (uniqueVertices.contains(vertex)) {
+      if (!uniqueVertices.contains(vertex)) {
         uniqueVertices[vertex] = static_cast<uint32_t>(_vertexData.size());
         _vertexData.push_back(vertex);
       }
@@ -57,24 +81,28 @@ VikingRoom::~VikingRoom() {
   Engine& engine = Engine::instance();
 
   vkDestroyPipelineLayout(engine._device, _pipelineLayout, nullptr);
-  vkDestroyPipeline(engine._device, _pipeline, nullptr);
 }
 
 void VikingRoom::build_pipeline() {
   Engine& engine = Engine::instance();
 
   VkShaderModule triangleFragShader{};
-  if (!vkutil::load_shader_module("shaders/colored_triangle.frag.spv",
-                                  engine._device, &triangleFragShader)) {
+  if (!vkutil::load_shader_module(spirv::colored_triangle_frag, engine._device,
+                                  &triangleFragShader)) {
     throw std::runtime_error(
         "Error when building the triangle fragment shader module");
   }
 
   fmt::print("Triangle fragment shader succesfully loaded\n");
 
+  // with vertex pulling the shader reads the vertices itself
+  const bool pulling = engine._config.vertexPulling;
+  const std::span<const uint32_t> vertexCode =
+      pulling ? std::span<const uint32_t>(spirv::colored_triangle_pulled_vert)
+              : std::span<const uint32_t>(spirv::colored_triangle_vert);
   VkShaderModule triangleVertexShader{};
-  if (!vkutil::load_shader_module("shaders/colored_triangle.vert.spv",
-                                  engine._device, &triangleVertexShader)) {
+  if (!vkutil::load_shader_module(vertexCode, engine._device,
+                                  &triangleVertexShader)) {
     throw std::runtime_error(
         "Error when building the triangle fragment shader module");
   }
@@ -96,20 +124,23 @@ void VikingRoom::build_pipeline() {
   attributeDescriptions[1].offset = offsetof(Vertex, color);
   attributeDescriptions[2].binding = 0;
   attributeDescriptions[2].location = 4;
-  attributeDescriptions[2].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+  // a vec2, four components would read past the end of the last vertex
+  attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
   attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
 
   VkPushConstantRange pushConstant{};
   pushConstant.offset = 0;
-  pushConstant.size = sizeof(PushConstants);
-  pushConstant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstant.size = sizeof(DrawPushConstants);
+  pushConstant.stageFlags =
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
   VkPipelineLayoutCreateInfo pipeline_layout_info{};
   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipeline_layout_info.pNext = nullptr;
   pipeline_layout_info.pPushConstantRanges = &pushConstant;
   pipeline_layout_info.pushConstantRangeCount = 1;
-  pipeline_layout_info.pSetLayouts = &engine._descriptorSetLayout;
+  VkDescriptorSetLayout setLayout = engine._bindless->layout();
+  pipeline_layout_info.pSetLayouts = &setLayout;
   pipeline_layout_info.setLayoutCount = 1;
 
   vk_check(vkCreatePipelineLayout(engine._device, &pipeline_layout_info,
@@ -117,6 +148,7 @@ void VikingRoom::build_pipeline() {
 
   PipelineBuilder pipelineBuilder;
   pipelineBuilder._pipelineLayout = _pipelineLayout;
+  pipelineBuilder.set_flags(engine._bindless->pipeline_flags());
   pipelineBuilder.set_shaders(triangleVertexShader, triangleFragShader);
   pipelineBuilder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
   pipelineBuilder.set_polygon_mode(VK_POLYGON_MODE_FILL);
@@ -124,62 +156,79 @@ void VikingRoom::build_pipeline() {
                                 VK_FRONT_FACE_COUNTER_CLOCKWISE);
   pipelineBuilder.set_multisampling_none();
   pipelineBuilder.disable_blending();
-  pipelineBuilder.disable_depthtest();
-  pipelineBuilder.vertex_input(std::span(&bindingDescription, 1),
-                               attributeDescriptions);
+  if (!pulling) {
+    pipelineBuilder.vertex_input(std::span(&bindingDescription, 1),
+                                 attributeDescriptions);
+  }
 
   // connect the image format we will draw into, from draw image
   pipelineBuilder.set_color_attachment_format(engine._drawImage.format);
-  pipelineBuilder.set_depth_format(VK_FORMAT_UNDEFINED);
+  pipelineBuilder.set_depth_format(DEPTH_FORMAT);
 
-  _pipeline = pipelineBuilder.build_pipeline(engine._device);
+  _pipelines.build(pipelineBuilder, std::span(&_material.features, 1));
 
   vkDestroyShaderModule(engine._device, triangleFragShader, nullptr);
   vkDestroyShaderModule(engine._device, triangleVertexShader, nullptr);
 }
 
-void VikingRoom::draw(VkCommandBuffer cmd) {
+void VikingRoom::draw(DrawContext& ctx) {
   Engine& engine = Engine::instance();
-  FrameData& frame = engine.get_current_frame();
-
-  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline);
 
-  glm::mat4 Projection = glm::perspective(
-      glm::radians(45.0F),
-      float(engine._drawExtent.width) / float(engine._drawExtent.height), 0.1F,
-      10.0F);
-  Projection[1][1] *= -1;
-
-  glm::mat4 View =
-      glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f),
-                  glm::vec3(0.0f, 0.0f, 1.0f));
+  const bool prepass = engine._depthPrepass && _material.depthPrepass;
+  VkPipeline pipeline = engine._uberShaders
+                            ? _pipelines.uber(prepass)
+                            : _pipelines.get(_material.features, prepass);
+  VkPipeline depthPipeline = prepass ? _pipelines.depth_only() : nullptr;
 
+  // the camera is applied on the gpu, see Engine::_camera
   glm::mat4 Model{glm::rotate(glm::mat4(1.0F), glm::radians(90.0F),
                               glm::vec3(0.0F, 0.0F, 1.0F))};
 
-  glm::mat4 mvp = Projection * View * Model;
-
-  PushConstants pushConstants;
-  pushConstants.mvp = mvp;
-  pushConstants.col = glm::vec3(1., 0., 0.);
-
-  vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
-                     sizeof(PushConstants), &pushConstants);
-
-  std::array<VkBuffer, 1> vertexBuffers{_meshBuffers->vertexBuffer._buffer};
-  std::array<VkDeviceSize, 1> offsets{0};
-  vkCmdBindVertexBuffers(cmd, 0, 1, vertexBuffers.data(), offsets.data());
-
-  vkCmdBindIndexBuffer(cmd, _meshBuffers->indexBuffer._buffer, 0,
-                       VK_INDEX_TYPE_UINT32);
+  // copies are shrunk into a square grid covering the original room
+  const uint32_t copies = std::max(engine._config.drawCopies, 1U);
+  const auto side = static_cast<uint32_t>(std::ceil(std::sqrt(float(copies))));
+  const float cell = 2.F / float(side);
+  if (copies > 1) {
+    Model = glm::scale(glm::mat4(1.F), glm::vec3(cell)) * Model;
+  }
 
-  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout,
-                          0, 1, &frame._descriptorSet, 0, nullptr);
+  for (uint32_t i = 0; i < copies; i++) {
+    glm::mat4 model = Model;
+    if (copies > 1) {
+      glm::vec3 offset{-1.F + cell * (float(i % side) + .5F),
+                       -1.F + cell * (float(i / side) + .5F), 0.F};
+      model = glm::translate(glm::mat4(1.F), offset) * Model;
+    }
 
-  vkCmdDrawIndexed(cmd, _indexData.size(), 1, 0, 0, 0);
+    ctx.objects.push_back(RenderObject{
+        .pipeline = pipeline,
+        .depthPipeline = depthPipeline,
+        .layout = _pipelineLayout,
+        .vertexBuffer = engine._config.vertexPulling
+                            ? VK_NULL_HANDLE
+                            : _meshBuffers->vertexBuffer._buffer,
+        .indexBuffer = _meshBuffers->indexBuffer._buffer,
+        .draw =
+            DrawData{
+                .model = model,
+                .boundsMin = glm::vec4(_boundsMin, 1.F),
+                .boundsMax = glm::vec4(_boundsMax, 1.F),
+                .col = glm::vec3(1., 0., 0.),
+                .features = _material.features,
+                .textureIndex = _material.textureIndex,
+                .samplerIndex = _material.samplerIndex,
+                .indexCount = static_cast<uint32_t>(_indexData.size()),
+                .firstIndex = 0,
+                .vertices = _meshBuffers->vertexBufferAddress,
+            },
+    });
+  }
 }
 
 void VikingRoom::init_data() {
   Engine& engine = Engine::instance();
   _meshBuffers.emplace(std::move(engine.upload_mesh(_vertexData, _indexData)));
+
+  _material.textureIndex = engine._textureIndex;
+  _material.samplerIndex = engine._samplerIndex;
 }
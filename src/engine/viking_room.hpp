@@ -1,6 +1,6 @@
 #pragma once
 
-#include <vulkan/vulkan.h>
+#include <volk.h>
 
 #include <expected>
 #include <glm/glm.hpp>
@@ -8,6 +8,8 @@
 #include <string_view>
 #include <vector>
 
+#include "material.hpp"
+#include "render_object.hpp"
 #include "struct.hpp"
 
 constexpr std::string_view VIKING_MODEL = "models/viking_room.obj";
@@ -24,19 +26,20 @@ class VikingRoom {
 
   void load_model();
   void build_pipeline();
-  void draw(VkCommandBuffer cmd);
+  void draw(DrawContext &ctx);
   void init_data();
 
  private:
-  struct PushConstants {
-    glm::mat4 mvp;
-    glm::vec3 col;
-  };
-
   std::vector<Vertex> _vertexData;
   std::vector<uint32_t> _indexData;
+  // model space bounding box, for culling
+  glm::vec3 _boundsMin{0.F};
+  glm::vec3 _boundsMax{0.F};
+
+  Material _material{.features = MATERIAL_FEATURE_TEXTURED,
+                     .depthPrepass = true};
 
-  VkPipeline _pipeline{};
+  MaterialPipelines _pipelines;
   VkPipelineLayout _pipelineLayout{};
   VkDeviceAddress _vertexBufferAddress{};
   std::optional<GPUMeshBuffers> _meshBuffers;
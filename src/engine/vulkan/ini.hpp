@@ -1,6 +1,6 @@
 #pragma once
 
-#include <vulkan/vulkan.h>
+#include <volk.h>
 
 namespace vkini {
 
@@ -15,14 +15,15 @@ constexpr VkCommandPoolCreateInfo command_pool_create_info(
 }
 
 constexpr VkCommandBufferAllocateInfo command_buffer_allocate_info(
-    VkCommandPool pool, uint32_t count = 1) {
+    VkCommandPool pool, uint32_t count = 1,
+    VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY) {
   VkCommandBufferAllocateInfo info = {};
   info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
   info.pNext = nullptr;
 
   info.commandPool = pool;
   info.commandBufferCount = count;
-  info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  info.level = level;
   return info;
 }
 constexpr VkCommandBufferBeginInfo command_buffer_begin_info(
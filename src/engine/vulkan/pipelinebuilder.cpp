@@ -3,6 +3,7 @@
 
 #include <fmt/core.h>
 
+#include "../cpu_profiler.hpp"
 #include "ini.hpp"
 
 PipelineBuilder::PipelineBuilder() { clear(); }
@@ -31,10 +32,16 @@ void PipelineBuilder::clear() {
 
   _renderInfo = {.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO};
 
+  _specializationInfo = nullptr;
+
+  _flags = 0;
+
   _shaderStages.clear();
 }
 
 VkPipeline PipelineBuilder::build_pipeline(VkDevice device) {
+  PROFILE_SCOPE("build_pipeline");
+
   // make viewport state from our stored viewport and scissor.
   // at the moment we wont support multiple viewports or scissors
   VkPipelineViewportStateCreateInfo viewportState = {};
@@ -53,7 +60,7 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device) {
 
   colorBlending.logicOpEnable = VK_FALSE;
   colorBlending.logicOp = VK_LOGIC_OP_COPY;
-  colorBlending.attachmentCount = 1;
+  colorBlending.attachmentCount = _renderInfo.colorAttachmentCount;
   colorBlending.pAttachments = &_colorBlendAttachment;
 
   // build the actual pipeline
@@ -63,6 +70,11 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device) {
       .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
   // connect the renderInfo to the pNext extension mechanism
   pipelineInfo.pNext = &_renderInfo;
+  pipelineInfo.flags = _flags;
+
+  for (VkPipelineShaderStageCreateInfo& stage : _shaderStages) {
+    stage.pSpecializationInfo = _specializationInfo;
+  }
 
   pipelineInfo.stageCount = (uint32_t)_shaderStages.size();
   pipelineInfo.pStages = _shaderStages.data();
@@ -95,6 +107,10 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device) {
   return newPipeline;
 }
 
+void PipelineBuilder::set_flags(VkPipelineCreateFlags flags) {
+  _flags = flags;
+}
+
 void PipelineBuilder::set_shaders(VkShaderModule vertexShader,
                                   VkShaderModule fragmentShader) {
   _shaderStages.clear();
@@ -106,6 +122,11 @@ void PipelineBuilder::set_shaders(VkShaderModule vertexShader,
       VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader));
 }
 
+void PipelineBuilder::set_specialization_info(
+    const VkSpecializationInfo* info) {
+  _specializationInfo = info;
+}
+
 void PipelineBuilder::set_input_topology(VkPrimitiveTopology topology) {
   _inputAssembly.topology = topology;
   // we are not going to use primitive restart on the entire tutorial so leave
@@ -214,3 +235,13 @@ void PipelineBuilder::enable_depthtest(bool depthWriteEnable, VkCompareOp op) {
   _depthStencil.minDepthBounds = 0.f;
   _depthStencil.maxDepthBounds = 1.f;
 }
+
+void PipelineBuilder::set_depth_only() {
+  std::erase_if(_shaderStages,
+                [](const VkPipelineShaderStageCreateInfo& stage) {
+                  return stage.stage == VK_SHADER_STAGE_FRAGMENT_BIT;
+                });
+
+  _renderInfo.colorAttachmentCount = 0;
+  _renderInfo.pColorAttachmentFormats = nullptr;
+}
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <vulkan/vulkan.h>
+#include <volk.h>
 
 #include <span>
 #include <vector>
@@ -18,13 +18,18 @@ class PipelineBuilder {
   VkPipelineDepthStencilStateCreateInfo _depthStencil;
   VkPipelineRenderingCreateInfo _renderInfo;
   VkFormat _colorAttachmentformat;
+  const VkSpecializationInfo* _specializationInfo;
+  VkPipelineCreateFlags _flags;
 
   PipelineBuilder();
 
   void clear();
 
   VkPipeline build_pipeline(VkDevice device);
+  void set_flags(VkPipelineCreateFlags flags);
   void set_shaders(VkShaderModule vertexShader, VkShaderModule fragmentShader);
+  // applied to every shader stage. must stay alive until build_pipeline
+  void set_specialization_info(const VkSpecializationInfo* info);
   void set_input_topology(VkPrimitiveTopology topology);
   void set_polygon_mode(VkPolygonMode mode);
   void set_cull_mode(VkCullModeFlags cullMode, VkFrontFace frontFace);
@@ -40,4 +45,7 @@ class PipelineBuilder {
   void set_depth_format(VkFormat format);
   void disable_depthtest();
   void enable_depthtest(bool depthWriteEnable, VkCompareOp op);
+  // drops the fragment shader and the color attachment, for pipelines that
+  // only write depth
+  void set_depth_only();
 };
@@ -1,32 +1,122 @@
 #include "swapchain.hpp"
 
-#include "../engine.hpp"
+#include <array>
+#include <span>
+#include <vector>
 
-Swapchain::Swapchain(Engine& engine)
-    : Swapchain(engine._windowExtent, engine._gpu, engine._device,
-                engine._surface) {}
+#include "../helpers.hpp"
 
-Swapchain::Swapchain(vk::Extent2D extent, vk::PhysicalDevice& gpu,
-                     vk::Device& device, vk::SurfaceKHR& surface) {
+namespace {
+
+// preferred replacements for each mode, best first. fifo comes last for
+// every mode since it is the only one guaranteed to be supported
+std::span<const VkPresentModeKHR> present_mode_fallbacks(
+    VkPresentModeKHR mode) {
+  static constexpr std::array IMMEDIATE{VK_PRESENT_MODE_MAILBOX_KHR,
+                                        VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+  static constexpr std::array MAILBOX{VK_PRESENT_MODE_IMMEDIATE_KHR};
+
+  switch (mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+      return IMMEDIATE;
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+      return MAILBOX;
+    default:
+      return {};
+  }
+}
+
+}  // namespace
+
+void set_present_mode(vkb::SwapchainBuilder& builder, VkPresentModeKHR mode) {
+  builder.set_desired_present_mode(mode);
+  for (VkPresentModeKHR fallback : present_mode_fallbacks(mode)) {
+    builder.add_fallback_present_mode(fallback);
+  }
+  builder.add_fallback_present_mode(VK_PRESENT_MODE_FIFO_KHR);
+}
+
+Swapchain::Swapchain(VkPhysicalDevice gpu, VkDevice device,
+                     VkSurfaceKHR surface, VkExtent2D extent,
+                     VkPresentModeKHR presentMode, uint32_t imageCount,
+                     VkImageUsageFlags usage, VkSwapchainKHR oldSwapchain)
+    : _device{device} {
   vkb::SwapchainBuilder swapchainBuilder{gpu, device, surface};
-  vkb::Swapchain vkbSwapchain =
-      swapchainBuilder
-          //.use_default_format_selection()
-          .set_desired_format(VkSurfaceFormatKHR{
-              .format = VK_FORMAT_B8G8R8A8_UNORM,
-              .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR})
-          // use vsync present mode
-          .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
-          .set_desired_extent(extent.width, extent.height)
-          .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
-          .build()
-          .value();
+  swapchainBuilder
+      //.use_default_format_selection()
+      .set_desired_format(choose_format(gpu, surface))
+      .set_desired_extent(extent.width, extent.height)
+      .add_image_usage_flags(usage)
+      .set_old_swapchain(oldSwapchain);
+
+  set_present_mode(swapchainBuilder, presentMode);
+  if (imageCount != 0) {
+    swapchainBuilder.set_desired_min_image_count(imageCount);
+  }
+
+  vkb::Swapchain vkbSwapchain = swapchainBuilder.build().value();
 
   _extent = vkbSwapchain.extent;
+  _format = vkbSwapchain.image_format;
+  _presentMode = vkbSwapchain.present_mode;
   // store swapchain and its related images
   _swapchain = vkbSwapchain.swapchain;
-  auto images = vkbSwapchain.get_images().value();
-  _images = {images.begin(), images.end()};
-  auto views = vkbSwapchain.get_image_views().value();
-  _views = {views.begin(), views.end()};
+  _images = vkbSwapchain.get_images().value();
+  _views = vkbSwapchain.get_image_views().value();
+}
+
+Swapchain::~Swapchain() {
+  // the images belong to the swapchain
+  for (VkImageView view : _views) {
+    vkDestroyImageView(_device, view, nullptr);
+  }
+  if (_swapchain != VK_NULL_HANDLE) {
+    vkDestroySwapchainKHR(_device, _swapchain, nullptr);
+  }
+}
+
+VkSurfaceFormatKHR Swapchain::choose_format(VkPhysicalDevice gpu,
+                                            VkSurfaceKHR surface) {
+  uint32_t count{0};
+  vk_check(vkGetPhysicalDeviceSurfaceFormatsKHR(gpu, surface, &count, nullptr));
+  std::vector<VkSurfaceFormatKHR> formats(count);
+  vk_check(vkGetPhysicalDeviceSurfaceFormatsKHR(gpu, surface, &count,
+                                                formats.data()));
+
+  for (const VkSurfaceFormatKHR& format : formats) {
+    if (format.format == DESIRED_FORMAT &&
+        format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+      return format;
+    }
+  }
+  if (formats.empty()) {
+    return {DESIRED_FORMAT, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+  }
+  return formats.front();
+}
+
+bool Swapchain::supports_storage(VkPhysicalDevice gpu, VkSurfaceKHR surface) {
+  VkSurfaceCapabilitiesKHR capabilities{};
+  vk_check(
+      vkGetPhysicalDeviceSurfaceCapabilitiesKHR(gpu, surface, &capabilities));
+
+  // the format actually chosen, which needn't be DESIRED_FORMAT
+  VkFormatProperties properties{};
+  vkGetPhysicalDeviceFormatProperties(
+      gpu, choose_format(gpu, surface).format, &properties);
+
+  return (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT) != 0 &&
+         (properties.optimalTilingFeatures &
+          VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+}
+
+void Swapchain::retire(RetireQueue& queue, uint64_t retireValue) {
+  for (VkImageView view : _views) {
+    queue.retire(view, retireValue);
+  }
+  queue.retire(_swapchain, retireValue);
+
+  _swapchain = VK_NULL_HANDLE;
+  _images.clear();
+  _views.clear();
 }
@@ -1,29 +1,68 @@
 #pragma once
 
 #include <VkBootstrap.h>
+#include <volk.h>
 
+#include <cstdint>
+#include <span>
 #include <vector>
-#include <vulkan/vulkan.hpp>
 
-#include "../common.hpp"
+#include "../deletion_queue.hpp"
 
+// asks for mode and, if the surface doesn't support it, the closest mode that
+// it does. fifo is always available so negotiation can't fail
+void set_present_mode(vkb::SwapchainBuilder& builder, VkPresentModeKHR mode);
+
+// owns a swapchain and the views of its images
 class Swapchain {
  public:
-  explicit Swapchain(Engine& engine = get_engine());
+  // used when the surface has it, see choose_format
+  static constexpr VkFormat DESIRED_FORMAT = VK_FORMAT_B8G8R8A8_UNORM;
 
-  Swapchain(vk::Extent2D extent, vk::PhysicalDevice& gpu, vk::Device& device,
-            vk::SurfaceKHR& surface);
+  // usage is what the images are used for besides presenting. oldSwapchain
+  // lets the driver hand resources over to the new swapchain. it
+  // is retired by this call but stays owned by the caller, who has to destroy
+  // it once nothing uses its images anymore
+  Swapchain(VkPhysicalDevice gpu, VkDevice device, VkSurfaceKHR surface,
+            VkExtent2D extent,
+            VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR,
+            uint32_t imageCount = 0,
+            VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
 
-  Swapchain() = delete;
   Swapchain(const Swapchain&) = delete;
-  Swapchain(Swapchain&&) noexcept = default;
+  Swapchain(Swapchain&&) = delete;
   Swapchain& operator=(const Swapchain&) = delete;
-  Swapchain& operator=(Swapchain&&) noexcept = delete;
-  ~Swapchain() = default;
+  Swapchain& operator=(Swapchain&&) = delete;
+  // destroys the views and the swapchain, the gpu has to be done with them
+  ~Swapchain();
+
+  // the format swapchains of surface are created with: DESIRED_FORMAT in
+  // srgb if the surface supports it, otherwise the first format it reports
+  static VkSurfaceFormatKHR choose_format(VkPhysicalDevice gpu,
+                                          VkSurfaceKHR surface);
+
+  // whether swapchains of surface, in the format choose_format picks, can be
+  // storage images
+  static bool supports_storage(VkPhysicalDevice gpu, VkSurfaceKHR surface);
+
+  // hands the swapchain and its views to queue instead of destroying them
+  // right away, leaving this empty
+  void retire(RetireQueue& queue, uint64_t retireValue);
+
+  [[nodiscard]] VkSwapchainKHR handle() const { return _swapchain; }
+  [[nodiscard]] VkExtent2D extent() const { return _extent; }
+  [[nodiscard]] VkFormat format() const { return _format; }
+  [[nodiscard]] VkPresentModeKHR present_mode() const { return _presentMode; }
+  [[nodiscard]] std::span<const VkImage> images() const { return _images; }
+  [[nodiscard]] std::span<const VkImageView> views() const { return _views; }
 
  private:
-  vk::Extent2D _extent;
-  vk::SwapchainKHR _swapchain;
-  std::vector<vk::Image> _images;
-  std::vector<vk::ImageView> _views;
+  VkDevice _device;
+  VkSwapchainKHR _swapchain{};
+  VkExtent2D _extent{};
+  VkFormat _format{DESIRED_FORMAT};
+  VkPresentModeKHR _presentMode{};
+  std::vector<VkImage> _images;
+  std::vector<VkImageView> _views;
 };
@@ -2,8 +2,8 @@
 
 #include <fmt/format.h>
 
-#include <fstream>
-#include <vector>
+#include <cmath>
+#include <span>
 
 #include "ini.hpp"
 
@@ -96,33 +96,16 @@ void copy_buffer_to_image(VkCommandBuffer cmd, VkBuffer source,
                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
 }
 
-bool load_shader_module(const char* filePath, VkDevice device,
+bool load_shader_module(std::span<const uint32_t> code, VkDevice device,
                         VkShaderModule* outShaderModule) {
-  std::ifstream file(filePath, std::ios::ate | std::ios::binary);
-
-  if (!file.is_open()) {
-    fmt::print("failed to open shader file\n");
-    return false;
-  }
-
-  size_t fileSize = (size_t)file.tellg();
-
-  // spirv expects the buffer to be on uint32, so make sure to reserve a int
-  // vector big enough for the entire file
-  std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
-
-  file.seekg(0);
-
-  file.read((char*)buffer.data(), fileSize);
-
-  file.close();
-
+  // the spirv is embedded in the binary at build time (see
+  // shaders/CMakeLists.txt), so there is nothing to read from disk here
   VkShaderModuleCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
   createInfo.pNext = nullptr;
 
-  createInfo.codeSize = buffer.size() * sizeof(uint32_t);
-  createInfo.pCode = buffer.data();
+  createInfo.codeSize = code.size_bytes();
+  createInfo.pCode = code.data();
 
   VkShaderModule shaderModule;
   if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) !=
@@ -134,4 +117,17 @@ bool load_shader_module(const char* filePath, VkDevice device,
   return true;
 }
 
+glm::mat4 perspective_reverse_z(float fovy, float aspect, float zNear) {
+  const float f = 1.F / std::tan(fovy / 2.F);
+
+  // clip z is zNear and clip w the distance along -z, so depth is zNear
+  // divided by the distance
+  glm::mat4 projection{0.F};
+  projection[0][0] = f / aspect;
+  projection[1][1] = f;
+  projection[2][3] = -1.F;
+  projection[3][2] = zNear;
+  return projection;
+}
+
 }  // namespace vkutil
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <vk_mem_alloc.h>
+#include <volk.h>
 
+#include <glm/glm.hpp>
+#include <span>
 #include <vulkan/vulkan.hpp>
 
 #include "../struct.hpp"
@@ -18,9 +21,15 @@ void copy_image_to_image(VkCommandBuffer cmd, VkImage source,
 void copy_buffer_to_image(VkCommandBuffer cmd, VkBuffer source,
                           VkImage destination, uint32_t width, uint32_t height);
 
-bool load_shader_module(const char* filePath, VkDevice device,
+bool load_shader_module(std::span<const uint32_t> code, VkDevice device,
                         VkShaderModule* outShaderModule);
 
+// right handed perspective projection with reversed depth: the near plane maps
+// to 1 and infinitely far away to 0. spends the float precision where the
+// depth values are spread out the most, depth tests have to use GREATER.
+// fovy in radians, y is not flipped
+glm::mat4 perspective_reverse_z(float fovy, float aspect, float zNear);
+
 AllocatedBuffer create_buffer(size_t allocSize, VkBufferUsageFlags usage,
                               VmaMemoryUsage memoryUsage);
 
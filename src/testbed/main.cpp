@@ -6,20 +6,20 @@
 #include <SDL2/SDL_vulkan.h>
 #include <VkBootstrap.h>
 #include <backends/imgui_impl_sdl2.h>
-#include <backends/imgui_impl_vulkan.h>
 #include <fmt/format.h>
 #include <stb/stb_image.h>
 #include <vk_mem_alloc.h>
 
-#include <fstream>
 #include <glm/gtx/transform.hpp>
-#include <string_view>
+#include <shaders/basic_frag.hpp>
+#include <shaders/basic_vert.hpp>
+#include <span>
 
 constexpr uint32_t WINDOW_WIDTH = 1700;
 constexpr uint32_t WINDOW_HEIGHT = 900;
 
 void check(vk::Result res) { assert(res == vk::Result::eSuccess); }
-vk::ShaderModule load_shader_module(std::string_view filePath,
+vk::ShaderModule load_shader_module(std::span<const uint32_t> code,
                                     vk::Device device);
 
 int main() {
@@ -186,10 +186,8 @@ int main() {
     }
   }
 
-  vk::ShaderModule fragShader =
-      load_shader_module("shaders/triangle.frag.spv", device);
-  vk::ShaderModule vertShader =
-      load_shader_module("shaders/triangle.vert.spv", device);
+  vk::ShaderModule fragShader = load_shader_module(spirv::basic_frag, device);
+  vk::ShaderModule vertShader = load_shader_module(spirv::basic_vert, device);
 
   struct Vertex {
     glm::vec3 pos;
@@ -228,26 +226,11 @@ int main() {
   return 0;
 }
 
-vk::ShaderModule load_shader_module(std::string_view filePath,
+vk::ShaderModule load_shader_module(std::span<const uint32_t> code,
                                     vk::Device device) {
-  std::ifstream file(filePath.data(), std::ios::ate | std::ios::binary);
-  assert(file.is_open());
-
-  ssize_t fileSize = file.tellg();
-
-  // spirv expects the buffer to be on uint32, so make sure to reserve a int
-  // vector big enough for the entire file
-  std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
-
-  file.seekg(0);
-
-  file.read(reinterpret_cast<char*>(buffer.data()), fileSize);
-
-  file.close();
-
   vk::ShaderModuleCreateInfo info = {
-      .codeSize = buffer.size() * sizeof(uint32_t),
-      .pCode = buffer.data(),
+      .codeSize = code.size_bytes(),
+      .pCode = code.data(),
   };
 
   vk::ShaderModule shaderModule;